@@ -9,21 +9,96 @@
  *    height updates to guarantee O(log n) search, insert, and delete on average.
  */
 #include "AVLTree.h"
+#include "FrozenAVLTree.h"
+#include "KeyCompare.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <list>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
+namespace {
+
+/* Purpose:
+ *    Process-wide worker thread that frees detached subtrees off the caller's thread
+ * Behavior:
+ *    Started on first use and deliberately never destroyed, so trees with static
+ *    storage duration can still submit work while the program is exiting. Jobs run in
+ *    submission order; anything still queued at exit is left to the OS, and drain()
+ *    lets a caller wait for the queue to empty first
+ */
+class BackgroundReclaimer {
+    public:
+    static BackgroundReclaimer& instance() {
+        static BackgroundReclaimer* reclaimer = new BackgroundReclaimer();
+        return *reclaimer;
+    }
+
+    void submit(function<void()> job) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            jobs.push_back(std::move(job));
+        }
+        jobReady.notify_one();
+    }
+
+    void drain() {
+        unique_lock<mutex> lock(queueMutex);
+        queueIdle.wait(lock, [this] { return jobs.empty() && !running; });
+    }
+
+    private:
+    mutex queueMutex;
+    condition_variable jobReady;
+    condition_variable queueIdle;
+    deque<function<void()>> jobs;
+    bool running = false;
+    thread worker;
+
+    BackgroundReclaimer() : worker([this] { run(); }) {
+        worker.detach();
+    }
+
+    void run() {
+        unique_lock<mutex> lock(queueMutex);
+        while (true) {
+            jobReady.wait(lock, [this] { return !jobs.empty(); });
+            function<void()> job = std::move(jobs.front());
+            jobs.pop_front();
+            running = true;
+            lock.unlock();
+            job();
+            // destroy the captures before reporting idle
+            job = nullptr;
+            lock.lock();
+            running = false;
+            if (jobs.empty()) {
+                queueIdle.notify_all();
+            }
+        }
+    }
+};
+
+} // namespace
+
 /* Purpose:
  *    Construct a new AVL node with given key and value
  * Parameters:
- *    key – key for this node (const reference)
+ *    key – key for this node, already stored in the tree's key arena
  *    value – value stored (copied)
  * Behavior:
  *    Initializes child/parent pointers to nullptr and height to 0 (leaf)
  */
-AVLTree::AVLNode::AVLNode(const KeyType& key, const ValueType value) {
+AVLTree::AVLNode::AVLNode(std::string_view key, const ValueType value) {
     this->key = key;
     this->value = value;
     height = 0;
@@ -73,6 +148,9 @@ bool AVLTree::AVLNode::isLeaf() const {
 AVLTree::AVLTree() {
     root = nullptr;
     treeSize = 0;
+    backgroundReclaim = false;
+    trackedBytes = 0;
+    memoryBudget = 0;
 }
 
 /* Purpose:
@@ -89,7 +167,7 @@ AVLTree::AVLNode* AVLTree::copy(const AVLNode* node, AVLNode* parent) {
     if (!node) {
         return nullptr;
     }
-    AVLNode* newNode = new AVLNode(node->key, node->value);
+    AVLNode* newNode = createNode(node->key, node->value);
     newNode->parent = parent;
     newNode->height = node->height;
     newNode->left = copy(node->left, newNode);
@@ -105,6 +183,9 @@ AVLTree::AVLNode* AVLTree::copy(const AVLNode* node, AVLNode* parent) {
  *    Creates a deep copy of other by copying its root subtree and size
  */
 AVLTree::AVLTree(const AVLTree& other) {
+    backgroundReclaim = false;
+    trackedBytes = 0;
+    memoryBudget = 0;
     root = copy(other.root, nullptr);
     treeSize = other.treeSize;
 }
@@ -126,14 +207,72 @@ void AVLTree::clear(AVLNode* node) {
 }
 
 /* Purpose:
- *    Destructor
+ *    Detach every node from the tree and free them
  * Behavior:
- *    Frees all nodes and resets root/size
+ *    Leaves the tree empty and cancels any incremental copy. With background reclaim
+ *    enabled the detached nodes, the key arena and any recency list are freed by the
+ *    reclaimer thread, so this returns in O(1) without walking the tree
  */
-AVLTree::~AVLTree() {
-    clear(root);
+void AVLTree::releaseNodes() {
+    AVLNode* oldRoot = root;
     root = nullptr;
     treeSize = 0;
+    pendingCopies.clear();
+    trackedBytes = 0;
+    if (!oldRoot || !backgroundReclaim) {
+        clear(oldRoot);
+        keyArena = KeyArena();
+        recency.clear();
+        recencyIndex.clear();
+        return;
+    }
+
+    // the recency list and index hold a node per entry too, so they go to the
+    // reclaimer with the nodes instead of being cleared here
+    struct Detached {
+        KeyArena keys;
+        decltype(recency) list;
+        decltype(recencyIndex) index;
+    };
+    Detached* detached = new Detached{std::move(keyArena), std::move(recency), std::move(recencyIndex)};
+    recency.clear();
+    recencyIndex.clear();
+    BackgroundReclaimer::instance().submit([oldRoot, detached] {
+        clear(oldRoot);
+        delete detached;
+    });
+}
+
+/* Purpose:
+ *    Choose whether released nodes are freed on a background thread
+ * Parameters:
+ *    enabled – true to hand nodes to the reclaimer thread, false to free them inline
+ * Behavior:
+ *    Affects the destructor, assignment and beginIncrementalCopy. The setting belongs
+ *    to this tree object and is not copied by the copy constructor or assignment
+ */
+void AVLTree::setBackgroundReclaim(bool enabled) {
+    backgroundReclaim = enabled;
+}
+
+/* Purpose:
+ *    Wait until every subtree handed to the reclaimer thread has been freed
+ * Behavior:
+ *    Returns at once if nothing is queued. The reclaimer is never shut down, so work
+ *    still queued when the program exits is not freed; call this first where that
+ *    matters (leak checkers, memory measurements)
+ */
+void AVLTree::drainBackgroundReclaim() {
+    BackgroundReclaimer::instance().drain();
+}
+
+/* Purpose:
+ *    Destructor
+ * Behavior:
+ *    Frees all nodes (inline or in the background) and resets root/size
+ */
+AVLTree::~AVLTree() {
+    releaseNodes();
 }
 
 /* Purpose:
@@ -144,25 +283,45 @@ AVLTree::~AVLTree() {
  * Returns:
  *    pointer to node containing searchKey, or nullptr if not found
  * Behavior:
- *    Standard binary search tree recursive search using string comparison
+ *    Standard binary search tree recursive search; see searchFrom
  */
 AVLTree::AVLNode* AVLTree::search(AVLNode* node, const std::string& searchKey) const {
+    return searchFrom(node, searchKey, 0, 0);
+}
+
+/* Purpose:
+ *    Recursive search that skips key bytes already proven equal
+ * Parameters:
+ *    node – current node
+ *    searchKey – key to locate
+ *    lowPrefix – common prefix length of searchKey and the nearest key passed on the left
+ *    highPrefix – common prefix length of searchKey and the nearest key passed on the right
+ * Returns:
+ *    pointer to node containing searchKey, or nullptr if not found
+ * Behavior:
+ *    Every key in this subtree sorts between those two bounding keys, so it shares at
+ *    least min(lowPrefix, highPrefix) leading bytes with searchKey and the comparison
+ *    can start there. Each step does one three-way compare instead of up to three
+ */
+AVLTree::AVLNode* AVLTree::searchFrom(
+    AVLNode* node,
+    const std::string& searchKey,
+    size_t lowPrefix,
+    size_t highPrefix
+) const {
     if (node == nullptr) {
         return nullptr;
     }
 
-    if (searchKey == node->key) {
+    const KeyCompareResult cmp = compareKeys(searchKey, node->key, min(lowPrefix, highPrefix));
+    if (cmp.order == 0) {
         return node;
     }
 
-    if (searchKey < node->key) {
-        return search(node->left, searchKey);
+    if (cmp.order < 0) {
+        return searchFrom(node->left, searchKey, lowPrefix, cmp.mismatch);
     }
-
-    if (searchKey > node->key) {
-        return search(node->right, searchKey);
-    }
-    return nullptr;
+    return searchFrom(node->right, searchKey, cmp.mismatch, highPrefix);
 }
 
 /* Purpose:
@@ -183,6 +342,84 @@ size_t AVLTree::getHeight() const {
     return root->height;
 }
 
+/* Purpose:
+ *    Check the tree's structural invariants
+ * Returns:
+ *    true if every invariant holds, false otherwise
+ * Behavior:
+ *    Verifies parent links, strict key order, AVL balance, stored heights, treeSize,
+ *    the budget's trackedBytes total and the key arena's count of live bytes. While a
+ *    budget is set also checks that the recency list holds every entry exactly once and
+ *    that its index points at the right places; without one both must be empty. O(n),
+ *    meant for tests and debugging
+ */
+bool AVLTree::isValid() const {
+    size_t count = 0;
+    size_t bytes = 0;
+    if (checkSubtree(root, nullptr, nullptr, nullptr, count, bytes) < -1) {
+        return false;
+    }
+    if (count != treeSize || bytes != trackedBytes) {
+        return false;
+    }
+    if (keyArena.usedBytes() != bytes - count * KeyArena::allocationSize(sizeof(AVLNode))) {
+        return false;
+    }
+    if (memoryBudget == 0) {
+        return recency.empty() && recencyIndex.empty();
+    }
+    if (recency.size() != treeSize || recencyIndex.size() != treeSize) {
+        return false;
+    }
+    for (auto position = recency.begin(); position != recency.end(); ++position) {
+        const auto found = recencyIndex.find(*position);
+        if (found == recencyIndex.end() || found->second != position) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Purpose:
+ *    Recursively check one subtree for isValid
+ * Parameters:
+ *    node – subtree root
+ *    parent – node that node->parent must point at
+ *    low, high – nearest ancestors the subtree lies right / left of (nullptr if none);
+ *                every key must sort strictly between them
+ *    count – incremented for each node visited
+ *    bytes – accumulates nodeFootprint of each node visited
+ * Returns:
+ *    height of the subtree (-1 if empty), or -2 if an invariant is broken
+ */
+int AVLTree::checkSubtree(
+    const AVLNode* node,
+    const AVLNode* parent,
+    const AVLNode* low,
+    const AVLNode* high,
+    size_t& count,
+    size_t& bytes
+) {
+    if (!node) return -1;
+    if (node->parent != parent) return -2;
+    if ((low && !(low->key < node->key)) || (high && !(node->key < high->key))) {
+        return -2;
+    }
+
+    const int leftHeight = checkSubtree(node->left, node, low, node, count, bytes);
+    const int rightHeight = checkSubtree(node->right, node, node, high, count, bytes);
+    if (leftHeight < -1 || rightHeight < -1 || abs(leftHeight - rightHeight) > 1) {
+        return -2;
+    }
+    const int height = max(leftHeight, rightHeight) + 1;
+    if (static_cast<int>(node->height) != height) {
+        return -2;
+    }
+    count++;
+    bytes += nodeFootprint(node);
+    return height;
+}
+
 /* Purpose:
  *    Indexing operator to access value by key
  * Parameters:
@@ -195,6 +432,7 @@ size_t AVLTree::getHeight() const {
  */
 size_t& AVLTree::operator[](const std::string& key) {
     AVLNode* node = search(root, key);
+    touch(node);
     return node->value;
 }
 
@@ -203,13 +441,18 @@ size_t& AVLTree::operator[](const std::string& key) {
  * Parameters:
  *    other – tree to assign from
  * Behavior:
- *    Clears current tree and deep-copies other. Handles self-assignment
+ *    Releases current nodes and deep-copies other. Handles self-assignment.
+ *    This tree keeps its own memory budget; the copied entries start out ranked by key,
+ *    smallest key least recently used, since other's lookups are not ours.
+ *    Use beginIncrementalCopy/copyStep to spread a large copy over several calls
  */
 void AVLTree::operator=(const AVLTree& other) {
     if (this == &other) return;
-    clear(root);
+    releaseNodes();
     root = copy(other.root, nullptr);
     treeSize = other.treeSize;
+    rebuildRecency();
+    enforceBudget();
 }
 
 /* Purpose:
@@ -334,21 +577,24 @@ bool AVLTree::replaceChild(AVLNode*& parent, AVLNode*& currentChild, AVLNode*& n
  * Returns:
  *    newRoot – the node that becomes the root of the rotated subtree
  * Behavior:
- *    Updates parent pointers and root if necessary, and updates heights via setChild calls
+ *    Updates parent pointers and root if necessary, and updates heights via setChild calls.
+ *    node is taken by value: the caller's pointer is often the very child link being rewritten
  */
-AVLTree::AVLNode* AVLTree::rotateRight(AVLNode*& node) {
-    AVLNode* leftRightChild = node->left->right;
+AVLTree::AVLNode* AVLTree::rotateRight(AVLNode* node) {
     AVLNode* newRoot = node->left;
+    AVLNode* leftRightChild = newRoot->right;
+    AVLNode* parent = node->parent;
 
-    if (node->parent) {
-        replaceChild(node->parent, node, node->left);
+    if (parent) {
+        replaceChild(parent, node, newRoot);
     } else { // node is root
-        root = node->left;
+        root = newRoot;
         root->parent = nullptr;
     }
 
-    setChild(node->left, "right", node);
+    // node is now the lower of the two, so its height must be fixed first
     setChild(node, "left", leftRightChild);
+    setChild(newRoot, "right", node);
     return newRoot;
 }
 
@@ -359,21 +605,24 @@ AVLTree::AVLNode* AVLTree::rotateRight(AVLNode*& node) {
  * Returns:
  *    newRoot – the node that becomes the root of the rotated subtree
  * Behavior:
- *    Updates parent pointers and root if necessary, and updates heights via setChild calls
+ *    Updates parent pointers and root if necessary, and updates heights via setChild calls.
+ *    node is taken by value: the caller's pointer is often the very child link being rewritten
  */
-AVLTree::AVLNode* AVLTree::rotateLeft(AVLNode*& node) {
-    AVLNode* rightLeftChild = node->right->left;
+AVLTree::AVLNode* AVLTree::rotateLeft(AVLNode* node) {
     AVLNode* newRoot = node->right;
+    AVLNode* rightLeftChild = newRoot->left;
+    AVLNode* parent = node->parent;
 
-    if (node->parent) {
-        replaceChild(node->parent, node, node->right);
+    if (parent) {
+        replaceChild(parent, node, newRoot);
     } else { // node is root
         root = newRoot;
         root->parent = nullptr;
     }
 
-    setChild(node->right, "left", node);
+    // node is now the lower of the two, so its height must be fixed first
     setChild(node, "right", rightLeftChild);
+    setChild(newRoot, "left", node);
     return newRoot;
 }
 
@@ -387,7 +636,7 @@ AVLTree::AVLNode* AVLTree::rotateLeft(AVLNode*& node) {
  *    Performs single or double rotations for LL, LR, RR, RL cases as appropriate.
  *    Updates node heights before checking balance
  */
-AVLTree::AVLNode* AVLTree::rebalanceNode(AVLNode*& node) {
+AVLTree::AVLNode* AVLTree::rebalanceNode(AVLNode* node) {
     updateHeight(node);
     // Right heavy case
     if (getBalance(node) == -2) {
@@ -422,10 +671,11 @@ AVLTree::AVLNode* AVLTree::rebalanceNode(AVLNode*& node) {
  */
 bool AVLTree::insertNode(AVLNode*& current, AVLNode* parent, const std::string& newKey, size_t value) {
     if (current == nullptr) {
-        current = new AVLNode(newKey, value);
-        current->parent = parent;
+        AVLNode* created = createNode(newKey, value);
+        created->parent = parent;
+        current = created;
 
-        AVLNode* node = current->parent;
+        AVLNode* node = parent;
         while (node) {
             AVLNode* nodeParent = node->parent;
             rebalanceNode(node);
@@ -433,6 +683,7 @@ bool AVLTree::insertNode(AVLNode*& current, AVLNode* parent, const std::string&
         }
 
         treeSize++;
+        touch(created);
         return true;
     }
 
@@ -453,9 +704,15 @@ bool AVLTree::insertNode(AVLNode*& current, AVLNode* parent, const std::string&
  *    value – value to insert
  * Returns:
  *    true if inserted, false if key already present
+ * Behavior:
+ *    With a memory budget set, may evict least recently used entries (never the new one)
  */
 bool AVLTree::insert(const std::string& key, size_t value) {
-    return insertNode(root,nullptr, key, value);
+    if (!insertNode(root,nullptr, key, value)) {
+        return false;
+    }
+    enforceBudget();
+    return true;
 }
 
 /* Purpose:
@@ -503,8 +760,12 @@ bool AVLTree::removeNode(AVLNode*& current) {
             smallestInRight = smallestInRight->left;
         }
 
-        std::string newKey = smallestInRight->key;
-        int newValue = smallestInRight->value;
+        // toDelete takes over the successor's entry, so it also takes its recency slot.
+        // Swapping the key views hands toDelete's old key to the successor, which frees
+        // it when it is destroyed; the pair's total footprint is unchanged
+        swap(toDelete->key, smallestInRight->key);
+        toDelete->value = smallestInRight->value;
+        recencyTransfer(smallestInRight, toDelete);
 
         AVLNode* succParent = smallestInRight->parent;
         if (succParent->left == smallestInRight) {
@@ -513,9 +774,8 @@ bool AVLTree::removeNode(AVLNode*& current) {
             removeNode(succParent->right);
         }
 
-        current->key = newKey;
-        current->value = newValue;
-        rebalanceNode(current);
+        // rotations above may have re-pointed current's link, so keep working on toDelete
+        rebalanceNode(toDelete);
         return true; // we already deleted the one we needed to so return
     }
 
@@ -524,7 +784,7 @@ bool AVLTree::removeNode(AVLNode*& current) {
         parent = parent->parent;
     }
 
-    delete toDelete;
+    destroyNode(toDelete);
     return true;
 }
 
@@ -535,16 +795,33 @@ bool AVLTree::removeNode(AVLNode*& current) {
  * Returns:
  *    true if removed, false if key not found
  * Notes:
- *    Decrements treeSize when removal succeeds
+ *    Decrements treeSize when removal succeeds, and compacts the key arena if freed
+ *    slots have come to outweigh the live keys
  */
 bool AVLTree::remove(const std::string& key) {
     AVLNode* node = search(root, key);
-    if (node) {
-        const bool result = removeNode(node);
-        treeSize--;
-        return result;
+    if (!node) {
+        return false;
     }
-    return false;
+    eraseNode(node);
+    compactKeys();
+    return true;
+}
+
+/* Purpose:
+ *    Remove a node already found in the tree
+ * Parameters:
+ *    node – node to remove
+ * Behavior:
+ *    Decrements treeSize. The key arena is left as it is, so callers removing many
+ *    entries call compactKeys once at the end
+ */
+void AVLTree::eraseNode(AVLNode* node) {
+    // removeNode rewrites the pointer it is given, so hand it the parent's link
+    AVLNode*& link = !node->parent ? root
+        : (node->parent->left == node ? node->parent->left : node->parent->right);
+    removeNode(link);
+    treeSize--;
 }
 
 /* Purpose:
@@ -555,7 +832,9 @@ bool AVLTree::remove(const std::string& key) {
  *    true if found, false otherwise
  */
 bool AVLTree::contains(const std::string& key) const {
-    return search(root, key);
+    AVLNode* node = search(root, key);
+    touch(node);
+    return node;
 }
 
 /* Purpose:
@@ -568,6 +847,7 @@ bool AVLTree::contains(const std::string& key) const {
 optional<size_t> AVLTree::get(const std::string& key) const {
     AVLNode* node = search(root, key);
     if (node) {
+        touch(node);
         return node->value;
     }
     return nullopt;
@@ -591,15 +871,18 @@ void AVLTree::collectInRange(
 ) {
     if (!node) return;
 
-    if (node->key > lowKey) {
+    const int lowOrder = compareKeys(node->key, lowKey).order;
+    const int highOrder = compareKeys(node->key, highKey).order;
+
+    if (lowOrder > 0) {
         collectInRange(node->left, lowKey, highKey, result);
     }
 
-    if (node->key >= lowKey && node->key <= highKey) {
+    if (lowOrder >= 0 && highOrder <= 0) {
         result.push_back(node->value);
     }
 
-    if (node->key < highKey) {
+    if (highOrder < 0) {
         collectInRange(node->right, lowKey, highKey, result);
     }
 }
@@ -626,7 +909,7 @@ vector<size_t> AVLTree::findRange(const std::string& lowKey, const std::string&
 void AVLTree::collectKeys(const AVLNode* node, vector<string>& result) {
     if (!node) return;
     collectKeys(node->left, result);
-    result.push_back(node->key);
+    result.emplace_back(node->key);
     collectKeys(node->right, result);
 }
 
@@ -639,4 +922,858 @@ vector<std::string> AVLTree::keys() const {
     vector<std::string> result;
     collectKeys(root, result);
     return result;
-}
\ No newline at end of file
+}
+
+/* Purpose:
+ *    Check whether key begins with prefix
+ * Parameters:
+ *    key – key to test
+ *    prefix – prefix to look for
+ * Returns:
+ *    true if the first prefix.size() characters of key equal prefix
+ */
+bool AVLTree::hasPrefix(std::string_view key, const std::string& prefix) {
+    return key.size() >= prefix.size() && key.compare(0, prefix.size(), prefix) == 0;
+}
+
+/* Purpose:
+ *    Collect key/value pairs whose keys start with prefix into result (in sorted order)
+ * Parameters:
+ *    node – current node pointer
+ *    prefix – prefix every collected key must start with
+ *    result – vector to append matching pairs
+ * Behavior:
+ *    Keys sharing a prefix form one contiguous run in sorted order, so a node that is
+ *    below the prefix prunes its left subtree and a node past the run prunes its right subtree
+ */
+void AVLTree::collectWithPrefix(const AVLNode* node, const std::string& prefix, vector<EntryType>& result) {
+    if (!node) return;
+
+    const bool matches = hasPrefix(node->key, prefix);
+    const bool belowPrefix = !matches && node->key < prefix;
+
+    if (!belowPrefix) {
+        collectWithPrefix(node->left, prefix, result);
+    }
+
+    if (matches) {
+        result.emplace_back(node->key, node->value);
+    }
+
+    if (matches || belowPrefix) {
+        collectWithPrefix(node->right, prefix, result);
+    }
+}
+
+/* Purpose:
+ *    Return all key/value pairs whose keys start with prefix
+ * Parameters:
+ *    prefix – key prefix (e.g. "foo/bar/"); an empty prefix matches every key
+ * Returns:
+ *    vector of (key, value) pairs in ascending key order
+ */
+vector<AVLTree::EntryType> AVLTree::prefixScan(const std::string& prefix) const {
+    vector<EntryType> result;
+    collectWithPrefix(root, prefix, result);
+    return result;
+}
+
+/* Purpose:
+ *    Find the node with the smallest key above key (or equal to it when inclusive)
+ * Parameters:
+ *    key – key to compare against
+ *    inclusive – true to accept a node whose key equals key
+ * Returns:
+ *    pointer to the matching node, or nullptr if every key is below the bound
+ * Behavior:
+ *    Single root-to-leaf descent remembering the last node where we went left.
+ *    Carries common-prefix lengths down the path the same way searchFrom does
+ */
+const AVLTree::AVLNode* AVLTree::lowerBound(const std::string& key, bool inclusive) const {
+    const AVLNode* best = nullptr;
+    const AVLNode* node = root;
+    size_t lowPrefix = 0;
+    size_t highPrefix = 0;
+    while (node) {
+        const KeyCompareResult result = compareKeys(node->key, key, min(lowPrefix, highPrefix));
+        const int cmp = result.order;
+        if (cmp > 0 || (inclusive && cmp == 0)) {
+            best = node;
+            if (cmp == 0) break;
+            highPrefix = result.mismatch;
+            node = node->left;
+        } else {
+            lowPrefix = result.mismatch;
+            node = node->right;
+        }
+    }
+    return best;
+}
+
+/* Purpose:
+ *    Find the node with the largest key below key (or equal to it when inclusive)
+ * Parameters:
+ *    key – key to compare against
+ *    inclusive – true to accept a node whose key equals key
+ * Returns:
+ *    pointer to the matching node, or nullptr if every key is above the bound
+ * Behavior:
+ *    Single root-to-leaf descent remembering the last node where we went right.
+ *    Carries common-prefix lengths down the path the same way searchFrom does
+ */
+const AVLTree::AVLNode* AVLTree::upperBound(const std::string& key, bool inclusive) const {
+    const AVLNode* best = nullptr;
+    const AVLNode* node = root;
+    size_t lowPrefix = 0;
+    size_t highPrefix = 0;
+    while (node) {
+        const KeyCompareResult result = compareKeys(node->key, key, min(lowPrefix, highPrefix));
+        const int cmp = result.order;
+        if (cmp < 0 || (inclusive && cmp == 0)) {
+            best = node;
+            if (cmp == 0) break;
+            lowPrefix = result.mismatch;
+            node = node->right;
+        } else {
+            highPrefix = result.mismatch;
+            node = node->left;
+        }
+    }
+    return best;
+}
+
+/* Purpose:
+ *    Return the entry with the smallest key strictly greater than key
+ * Parameters:
+ *    key – key to search from (does not need to be in the tree)
+ * Returns:
+ *    optional (key, value) pair; nullopt if no larger key exists
+ */
+optional<AVLTree::EntryType> AVLTree::successor(const std::string& key) const {
+    const AVLNode* node = lowerBound(key, false);
+    if (node) {
+        return EntryType(KeyType(node->key), node->value);
+    }
+    return nullopt;
+}
+
+/* Purpose:
+ *    Return the entry with the largest key strictly less than key
+ * Parameters:
+ *    key – key to search from (does not need to be in the tree)
+ * Returns:
+ *    optional (key, value) pair; nullopt if no smaller key exists
+ */
+optional<AVLTree::EntryType> AVLTree::predecessor(const std::string& key) const {
+    const AVLNode* node = upperBound(key, false);
+    if (node) {
+        return EntryType(KeyType(node->key), node->value);
+    }
+    return nullopt;
+}
+
+/* Purpose:
+ *    Return the entry with the largest key less than or equal to key
+ * Parameters:
+ *    key – key to search from (does not need to be in the tree)
+ * Returns:
+ *    optional (key, value) pair; nullopt if every key is greater than key
+ */
+optional<AVLTree::EntryType> AVLTree::floor(const std::string& key) const {
+    const AVLNode* node = upperBound(key, true);
+    if (node) {
+        return EntryType(KeyType(node->key), node->value);
+    }
+    return nullopt;
+}
+
+/* Purpose:
+ *    Return the entry with the smallest key greater than or equal to key
+ * Parameters:
+ *    key – key to search from (does not need to be in the tree)
+ * Returns:
+ *    optional (key, value) pair; nullopt if every key is less than key
+ */
+optional<AVLTree::EntryType> AVLTree::ceiling(const std::string& key) const {
+    const AVLNode* node = lowerBound(key, true);
+    if (node) {
+        return EntryType(KeyType(node->key), node->value);
+    }
+    return nullopt;
+}
+
+/* Purpose:
+ *    Collect all (key, value) pairs in the tree (in-order) into result
+ * Parameters:
+ *    node – current node
+ *    result – vector to append pairs to
+ */
+void AVLTree::collectEntries(const AVLNode* node, vector<EntryType>& result) {
+    if (!node) return;
+    collectEntries(node->left, result);
+    result.emplace_back(node->key, node->value);
+    collectEntries(node->right, result);
+}
+
+/* Purpose:
+ *    Build a balanced subtree from the sorted entries in [first, last)
+ * Parameters:
+ *    sortedEntries – (key, value) pairs in strictly ascending key order
+ *    first, last – half-open index range to build from
+ *    parent – parent pointer for the new subtree root
+ * Returns:
+ *    pointer to new subtree root (nullptr if the range is empty)
+ * Behavior:
+ *    Picks the middle entry as the root and recurses on each half, so sibling
+ *    subtrees differ in size by at most one and the AVL property holds without rotations
+ */
+AVLTree::AVLNode* AVLTree::buildFromSorted(
+    const vector<EntryType>& sortedEntries,
+    size_t first,
+    size_t last,
+    AVLNode* parent
+) {
+    if (first >= last) {
+        return nullptr;
+    }
+    const size_t middle = first + (last - first) / 2;
+    AVLNode* newNode = createNode(sortedEntries[middle].first, sortedEntries[middle].second);
+    newNode->parent = parent;
+    newNode->left = buildFromSorted(sortedEntries, first, middle, newNode);
+    newNode->right = buildFromSorted(sortedEntries, middle + 1, last, newNode);
+    updateHeight(newNode);
+    return newNode;
+}
+
+/* Purpose:
+ *    Export the current contents into an immutable, read-optimised index
+ * Parameters:
+ *    storage – KeyStorage::FrontCoded trades some lookup speed for much smaller keys
+ *              when many keys share long prefixes
+ * Returns:
+ *    FrozenAVLTree holding a snapshot of every entry
+ * Behavior:
+ *    The tree itself is left untouched; later changes are not reflected in the snapshot
+ */
+FrozenAVLTree AVLTree::freeze(KeyStorage storage) const {
+    vector<EntryType> sorted;
+    sorted.reserve(treeSize);
+    collectEntries(root, sorted);
+    return FrozenAVLTree(sorted, storage);
+}
+
+/* Purpose:
+ *    Start copying other into this tree in bounded steps
+ * Parameters:
+ *    other – tree to copy from
+ * Behavior:
+ *    Releases the current contents and queues other's root; no nodes are copied until
+ *    copyStep is called. Until copyStep returns true this tree holds a subset of
+ *    other's entries and must not be modified, and other must not be modified or destroyed
+ */
+void AVLTree::beginIncrementalCopy(const AVLTree& other) {
+    if (this == &other) return;
+    releaseNodes();
+    if (other.root) {
+        pendingCopies.push_back({other.root, nullptr, false});
+    }
+    if (memoryBudget != 0) {
+        // sized up front so copyStep never stalls on rehashing the whole index
+        recencyIndex.reserve(other.treeSize);
+    }
+}
+
+/* Purpose:
+ *    Copy up to maxNodes more nodes of an incremental copy
+ * Parameters:
+ *    maxNodes – upper bound on nodes allocated by this call
+ * Returns:
+ *    true once the copy is complete (or none was in progress), false if work remains
+ * Behavior:
+ *    Depth-first clone using an explicit stack of (source, new parent, side) entries.
+ *    Heights are copied from the source, so the finished tree is identical to other.
+ *    With a memory budget set, each copied node is ranked as it is created, so the
+ *    finished copy is in key order like operator= and the call that completes it only
+ *    pays for trimming it to the budget
+ */
+bool AVLTree::copyStep(size_t maxNodes) {
+    if (pendingCopies.empty()) return true;
+    for (size_t copied = 0; copied < maxNodes && !pendingCopies.empty(); copied++) {
+        const PendingCopy next = pendingCopies.back();
+        pendingCopies.pop_back();
+
+        AVLNode* newNode = createNode(next.source->key, next.source->value);
+        newNode->height = next.source->height;
+        newNode->parent = next.parent;
+        if (!next.parent) {
+            root = newNode;
+        } else if (next.isLeft) {
+            next.parent->left = newNode;
+        } else {
+            next.parent->right = newNode;
+        }
+        treeSize++;
+        if (memoryBudget != 0) {
+            // among the nodes copied so far a left child sorts just below its parent and a
+            // right child just above it, and lower keys sit nearer the back
+            auto position = recency.begin();
+            if (next.parent) {
+                position = recencyIndex.find(next.parent)->second;
+                if (next.isLeft) ++position;
+            }
+            recencyIndex.emplace(newNode, recency.insert(position, newNode));
+        }
+
+        if (next.source->right) {
+            pendingCopies.push_back({next.source->right, newNode, false});
+        }
+        if (next.source->left) {
+            pendingCopies.push_back({next.source->left, newNode, true});
+        }
+    }
+    if (!pendingCopies.empty()) {
+        return false;
+    }
+    enforceBudget();
+    return true;
+}
+
+/* Purpose:
+ *    Report whether an incremental copy still has nodes left to copy
+ * Returns:
+ *    true if copyStep needs to be called again
+ */
+bool AVLTree::copyInProgress() const {
+    return !pendingCopies.empty();
+}
+
+/* Purpose:
+ *    Allocate a node and account for it
+ * Parameters:
+ *    key, value – entry for the new node
+ * Returns:
+ *    pointer to the new node (not yet linked into the tree)
+ * Behavior:
+ *    Copies the key into keyArena and adds the node's footprint to trackedBytes.
+ *    Callers that add a single entry rank it with touch; bulk builds call
+ *    rebuildRecency once they are done
+ */
+AVLTree::AVLNode* AVLTree::createNode(std::string_view key, ValueType value) {
+    AVLNode* node = new AVLNode(keyArena.store(key), value);
+    trackedBytes += nodeFootprint(node);
+    return node;
+}
+
+/* Purpose:
+ *    Free a single node that has already been unlinked from the tree
+ * Parameters:
+ *    node – node to delete
+ */
+void AVLTree::destroyNode(AVLNode* node) {
+    recencyErase(node);
+    trackedBytes -= nodeFootprint(node);
+    keyArena.release(node->key);
+    delete node;
+}
+
+/* Purpose:
+ *    Estimate the bytes held by one entry
+ * Parameters:
+ *    node – node to measure
+ * Returns:
+ *    allocated size of the node plus the arena bytes taken by its key
+ */
+size_t AVLTree::nodeFootprint(const AVLNode* node) {
+    return KeyArena::allocationSize(sizeof(AVLNode)) + KeyArena::footprint(node->key.size());
+}
+
+/* Purpose:
+ *    Report how much memory the tree uses
+ * Returns:
+ *    MemoryUsage broken down into nodes, key arena, allocator slack and recency list
+ * Behavior:
+ *    Walks every node, so this is O(n). Slack uses the same allocator model as the budget.
+ *    The budget counts keyBytes; the arena can hold more than that after removals,
+ *    since freed key slots are kept for reuse, but compactKeys keeps the excess under
+ *    one chunk plus an eighth of keyBytes
+ */
+AVLTree::MemoryUsage AVLTree::memoryUsage() const {
+    MemoryUsage usage{};
+    vector<const AVLNode*> pending;
+    if (root) pending.push_back(root);
+    while (!pending.empty()) {
+        const AVLNode* node = pending.back();
+        pending.pop_back();
+
+        usage.nodeCount++;
+        usage.nodeBytes += sizeof(AVLNode);
+        usage.allocatorSlack += KeyArena::allocationSize(sizeof(AVLNode)) - sizeof(AVLNode);
+        usage.keyBytes += KeyArena::footprint(node->key.size());
+
+        if (node->left) pending.push_back(node->left);
+        if (node->right) pending.push_back(node->right);
+    }
+    usage.keyArenaBytes = keyArena.reservedBytes();
+    usage.recencyBytes = recencyBytes();
+    usage.totalBytes = sizeof(AVLTree) + usage.nodeBytes + usage.keyArenaBytes + usage.allocatorSlack
+        + usage.recencyBytes;
+    return usage;
+}
+
+/* Purpose:
+ *    Limit the memory held by entries, turning the tree into a bounded cache
+ * Parameters:
+ *    maxBytes – budget for the entries' estimated footprint (0 removes the budget)
+ *    onEvict – optional callback run with each entry after it is trimmed
+ * Behavior:
+ *    Whenever an insert pushes the footprint over budget, least recently used entries
+ *    are removed until it fits again. Recency is only recorded while a budget is set, so
+ *    setting one on a tree without one ranks the existing entries by key, smallest key
+ *    least recently used. get, contains and operator[] count as uses and reorder the
+ *    recency list, so they are not safe to call concurrently while a budget is set.
+ *    The recency list itself counts against the budget. The key arena's free space
+ *    does not, but is compacted away before it passes KeyArena::ChunkSize plus an
+ *    eighth of the live key bytes, so memoryUsage().totalBytes stays within about that
+ *    much of the budget. Trims immediately if the tree is already over the new budget
+ */
+void AVLTree::setMemoryBudget(size_t maxBytes, EvictionCallback onEvict) {
+    const bool wasTracking = memoryBudget != 0;
+    memoryBudget = maxBytes;
+    evictionCallback = std::move(onEvict);
+    if (!wasTracking || maxBytes == 0) {
+        rebuildRecency();
+    }
+    enforceBudget();
+}
+
+/* Purpose:
+ *    Remove the memory budget and eviction callback
+ * Behavior:
+ *    Also drops the recency list; lookups stop reordering anything
+ */
+void AVLTree::clearMemoryBudget() {
+    memoryBudget = 0;
+    evictionCallback = nullptr;
+    rebuildRecency();
+}
+
+/* Purpose:
+ *    Evict least recently used entries until the footprint fits the budget
+ * Behavior:
+ *    Always keeps at least one entry, so a single oversized entry is not thrown away
+ *    as soon as it is inserted. The key arena is compacted once after the last eviction
+ */
+void AVLTree::enforceBudget() {
+    if (memoryBudget == 0) return;
+    bool evicted = false;
+    while (trackedBytes + recencyBytes() > memoryBudget && treeSize > 1) {
+        AVLNode* victim = recency.back();
+        const KeyType key(victim->key);
+        const ValueType value = victim->value;
+        eraseNode(victim);
+        evicted = true;
+        if (evictionCallback) {
+            evictionCallback(key, value);
+        }
+    }
+    if (evicted) {
+        compactKeys();
+    }
+}
+
+/* Purpose:
+ *    Copy the live keys into a fresh arena once freed space outweighs them
+ * Behavior:
+ *    The arena reuses a freed slot only for a key of the same size class, so when key
+ *    lengths drift its free lists can grow without bound. Once the free and unused
+ *    bytes exceed a chunk plus an eighth of the live key bytes, every key is copied in
+ *    key order into a new arena and the old one is freed. That is O(n), but it needs
+ *    about n / 8 released keys to trigger again, so it adds O(1) amortized per removal
+ *    and keeps reservedBytes within a chunk plus an eighth of the live key bytes
+ */
+void AVLTree::compactKeys() {
+    const size_t live = keyArena.usedBytes();
+    if (keyArena.reservedBytes() - live <= KeyArena::ChunkSize + live / 8) {
+        return;
+    }
+    KeyArena compacted;
+    vector<AVLNode*> pending;
+    AVLNode* node = root;
+    while (node || !pending.empty()) {
+        if (node) {
+            pending.push_back(node);
+            node = node->left;
+            continue;
+        }
+        node = pending.back();
+        pending.pop_back();
+        node->key = compacted.store(node->key);
+        node = node->right;
+    }
+    keyArena = std::move(compacted);
+}
+
+/* Purpose:
+ *    Mark node as the most recently used entry
+ * Parameters:
+ *    node – node that was just accessed or inserted (nullptr is ignored)
+ * Behavior:
+ *    Only records anything while a budget is set, so lookups stay read-only otherwise.
+ *    A node not yet in the list is added at the front
+ */
+void AVLTree::touch(AVLNode* node) const {
+    if (!node || memoryBudget == 0) return;
+    const auto found = recencyIndex.find(node);
+    if (found == recencyIndex.end()) {
+        recency.push_front(node);
+        recencyIndex.emplace(node, recency.begin());
+    } else if (found->second != recency.begin()) {
+        recency.splice(recency.begin(), recency, found->second);
+    }
+}
+
+/* Purpose:
+ *    Drop node from the recency list, if it is in it
+ * Parameters:
+ *    node – node about to be freed
+ */
+void AVLTree::recencyErase(const AVLNode* node) {
+    if (recencyIndex.empty()) return;
+    const auto found = recencyIndex.find(node);
+    if (found != recencyIndex.end()) {
+        recency.erase(found->second);
+        recencyIndex.erase(found);
+    }
+}
+
+/* Purpose:
+ *    Move to into the recency slot held by from
+ * Parameters:
+ *    from – node whose entry is moving to another node
+ *    to – node receiving the entry; its own slot is dropped
+ * Behavior:
+ *    Used when remove copies the successor's entry into the node being removed
+ */
+void AVLTree::recencyTransfer(const AVLNode* from, AVLNode* to) {
+    if (recencyIndex.empty()) return;
+    recencyErase(to);
+    const auto found = recencyIndex.find(from);
+    if (found == recencyIndex.end()) return;
+    const list<AVLNode*>::iterator position = found->second;
+    *position = to;
+    recencyIndex.erase(found);
+    recencyIndex.emplace(to, position);
+}
+
+/* Purpose:
+ *    Rank every entry from scratch after a bulk change
+ * Behavior:
+ *    Empties the list when no budget is set. Otherwise lists all entries in key order,
+ *    smallest key at the least recently used end
+ */
+void AVLTree::rebuildRecency() {
+    recency.clear();
+    recencyIndex.clear();
+    if (memoryBudget == 0 || !root) return;
+    vector<AVLNode*> nodes;
+    nodes.reserve(treeSize);
+    collectNodes(root, nodes);
+    recencyIndex.reserve(nodes.size());
+    for (AVLNode* node : nodes) {
+        recency.push_front(node);
+        recencyIndex.emplace(node, recency.begin());
+    }
+}
+
+/* Purpose:
+ *    Estimate the bytes held by the recency list and index
+ * Returns:
+ *    one list node and one hash node per tracked entry plus the bucket array, using the
+ *    same allocator model as nodeFootprint
+ */
+size_t AVLTree::recencyBytes() const {
+    // list node: two links and the entry; hash node: next link, key and list iterator
+    const size_t perEntry = 2 * KeyArena::allocationSize(3 * sizeof(void*));
+    const size_t buckets = recencyIndex.bucket_count() > 1 ? recencyIndex.bucket_count() * sizeof(void*) : 0;
+    return recency.size() * perEntry + buckets;
+}
+
+/* Purpose:
+ *    Height of a possibly empty subtree
+ * Returns:
+ *    node->height, or -1 for nullptr
+ */
+int AVLTree::heightOf(const AVLNode* node) {
+    return node ? static_cast<int>(node->height) : -1;
+}
+
+/* Purpose:
+ *    Return the node with the smallest key in a non-empty subtree
+ */
+AVLTree::AVLNode* AVLTree::minNode(AVLNode* node) {
+    while (node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+/* Purpose:
+ *    Return the in-order successor of node using parent links
+ * Parameters:
+ *    node – node in the tree
+ * Returns:
+ *    next node in ascending key order, or nullptr if node holds the largest key
+ */
+const AVLTree::AVLNode* AVLTree::nextNode(const AVLNode* node) {
+    if (node->right) {
+        return minNode(node->right);
+    }
+    while (node->parent && node->parent->right == node) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+/* Purpose:
+ *    Return the node with the largest key in a non-empty subtree
+ */
+AVLTree::AVLNode* AVLTree::maxNode(AVLNode* node) {
+    while (node->right) {
+        node = node->right;
+    }
+    return node;
+}
+
+/* Purpose:
+ *    Collect all nodes of a subtree (in-order) into result
+ * Parameters:
+ *    node – current node
+ *    result – vector to append node pointers to
+ */
+void AVLTree::collectNodes(AVLNode* node, vector<AVLNode*>& result) {
+    if (!node) return;
+    collectNodes(node->left, result);
+    result.push_back(node);
+    collectNodes(node->right, result);
+}
+
+/* Purpose:
+ *    Relink existing nodes in [first, last) into a balanced subtree
+ * Parameters:
+ *    nodes – nodes in ascending key order
+ *    first, last – half-open index range to link
+ *    parent – parent pointer for the subtree root
+ * Returns:
+ *    pointer to the subtree root (nullptr if the range is empty)
+ * Behavior:
+ *    Same shape as buildFromSorted, but reuses the nodes instead of allocating
+ */
+AVLTree::AVLNode* AVLTree::linkBalanced(const vector<AVLNode*>& nodes, size_t first, size_t last, AVLNode* parent) {
+    if (first >= last) {
+        return nullptr;
+    }
+    const size_t middle = first + (last - first) / 2;
+    AVLNode* node = nodes[middle];
+    node->parent = parent;
+    node->left = linkBalanced(nodes, first, middle, node);
+    node->right = linkBalanced(nodes, middle + 1, last, node);
+    updateHeight(node);
+    return node;
+}
+
+/* Purpose:
+ *    Take ownership of all of other's nodes
+ * Parameters:
+ *    other – tree to empty
+ * Returns:
+ *    other's former root; the caller must link it into this tree
+ * Behavior:
+ *    Moves the nodes' memory accounting and key arena over. With a budget set, other's
+ *    entries go in front of ours so freshly merged entries count as recently used: in
+ *    other's own recency order if it had a budget too, otherwise ranked by key. The
+ *    list splice is O(1) but moving other's index entries (or, without a budget on
+ *    other, walking its nodes) is O(m), so a budget makes merge's join path O(m)
+ */
+AVLTree::AVLNode* AVLTree::adoptNodes(AVLTree& other) {
+    AVLNode* otherRoot = other.root;
+    trackedBytes += other.trackedBytes;
+    keyArena.adopt(std::move(other.keyArena));
+    if (memoryBudget != 0 && other.memoryBudget != 0) {
+        // splice keeps the iterators in other's index valid, now pointing into our list
+        recency.splice(recency.begin(), other.recency);
+        recencyIndex.merge(other.recencyIndex);
+    } else if (memoryBudget != 0 && otherRoot) {
+        vector<AVLNode*> nodes;
+        collectNodes(otherRoot, nodes);
+        for (AVLNode* node : nodes) {
+            recency.push_front(node);
+            recencyIndex.emplace(node, recency.begin());
+        }
+    }
+
+    other.root = nullptr;
+    other.treeSize = 0;
+    other.trackedBytes = 0;
+    other.recency.clear();
+    other.recencyIndex.clear();
+    return otherRoot;
+}
+
+/* Purpose:
+ *    Join two AVL subtrees around a pivot, where every key in left < pivot < every key in right
+ * Parameters:
+ *    left, right – subtrees to join (either may be empty); both are detached roots
+ *    pivot – standalone node with no children
+ * Returns:
+ *    root of the joined tree, which also becomes this tree's root
+ * Behavior:
+ *    If the heights are within one, pivot simply becomes the root. Otherwise walk down
+ *    the inner spine of the taller tree to the first subtree no more than one level taller
+ *    than the shorter tree, hang pivot there, and rebalance back up. O(height difference)
+ */
+AVLTree::AVLNode* AVLTree::join(AVLNode* left, AVLNode* pivot, AVLNode* right) {
+    const int leftHeight = heightOf(left);
+    const int rightHeight = heightOf(right);
+    pivot->parent = nullptr;
+
+    if (abs(leftHeight - rightHeight) <= 1) {
+        setChild(pivot, "left", left);
+        setChild(pivot, "right", right);
+        root = pivot;
+        return root;
+    }
+
+    AVLNode* attachParent = nullptr;
+    if (leftHeight > rightHeight) {
+        root = left;
+        left->parent = nullptr;
+        AVLNode* spine = left;
+        while (heightOf(spine) > rightHeight + 1) {
+            attachParent = spine;
+            spine = spine->right;
+        }
+        setChild(pivot, "left", spine);
+        setChild(pivot, "right", right);
+        setChild(attachParent, "right", pivot);
+    } else {
+        root = right;
+        right->parent = nullptr;
+        AVLNode* spine = right;
+        while (heightOf(spine) > leftHeight + 1) {
+            attachParent = spine;
+            spine = spine->left;
+        }
+        setChild(pivot, "left", left);
+        setChild(pivot, "right", spine);
+        setChild(attachParent, "left", pivot);
+    }
+
+    AVLNode* node = attachParent;
+    while (node) {
+        AVLNode* nodeParent = node->parent;
+        rebalanceNode(node);
+        node = nodeParent;
+    }
+    return root;
+}
+
+/* Purpose:
+ *    Move every entry of other into this tree
+ * Parameters:
+ *    other – tree to absorb; left empty afterwards
+ *    policy – which value to keep when a key is in both trees
+ * Behavior:
+ *    Picks the cheapest strategy:
+ *      1) key ranges do not overlap – detach other's boundary entry as a pivot and join
+ *         the two trees in O(log n + log m); O(m) with a memory budget set, since
+ *         other's entries have to be ranked (see adoptNodes)
+ *      2) other is small – insert its entries one at a time, O(m log n)
+ *      3) otherwise – merge both in-order node lists and relink them into a balanced
+ *         tree, O(n + m), reusing the existing nodes
+ *    other must not have an incremental copy in progress
+ */
+void AVLTree::merge(AVLTree&& other, ConflictPolicy policy) {
+    if (this == &other || !other.root) return;
+
+    const size_t combinedSize = treeSize + other.treeSize;
+    if (!root || maxNode(root)->key < minNode(other.root)->key
+        || maxNode(other.root)->key < minNode(root)->key) {
+        const bool otherIsHigher = !root || maxNode(root)->key < minNode(other.root)->key;
+        // the boundary entry of other, next to this tree's range, becomes the pivot
+        const AVLNode* boundary = otherIsHigher ? minNode(other.root) : maxNode(other.root);
+        const KeyType pivotKey(boundary->key);
+        const ValueType pivotValue = boundary->value;
+        other.remove(pivotKey);
+
+        AVLNode* otherRoot = adoptNodes(other);
+        AVLNode* pivot = createNode(pivotKey, pivotValue);
+        if (otherIsHigher) {
+            join(root, pivot, otherRoot);
+        } else {
+            join(otherRoot, pivot, root);
+        }
+        treeSize = combinedSize;
+        touch(pivot);
+        enforceBudget();
+        return;
+    }
+
+    size_t logSize = 0;
+    while ((size_t{1} << logSize) <= treeSize) {
+        logSize++;
+    }
+    if (other.treeSize * logSize < combinedSize) {
+        vector<EntryType> incoming;
+        incoming.reserve(other.treeSize);
+        collectEntries(other.root, incoming);
+        other.releaseNodes();
+        for (const EntryType& entry : incoming) {
+            if (!insertNode(root, nullptr, entry.first, entry.second) && policy == ConflictPolicy::TakeOther) {
+                search(root, entry.first)->value = entry.second;
+            }
+        }
+        enforceBudget();
+        return;
+    }
+
+    vector<AVLNode*> ours;
+    vector<AVLNode*> theirs;
+    ours.reserve(treeSize);
+    theirs.reserve(other.treeSize);
+    collectNodes(root, ours);
+    collectNodes(other.root, theirs);
+    adoptNodes(other);
+
+    vector<AVLNode*> merged;
+    merged.reserve(combinedSize);
+    size_t i = 0;
+    size_t j = 0;
+    while (i < ours.size() || j < theirs.size()) {
+        if (j == theirs.size()) {
+            merged.push_back(ours[i++]);
+            continue;
+        }
+        if (i == ours.size()) {
+            merged.push_back(theirs[j++]);
+            continue;
+        }
+        const int order = compareKeys(ours[i]->key, theirs[j]->key).order;
+        if (order < 0) {
+            merged.push_back(ours[i++]);
+        } else if (order > 0) {
+            merged.push_back(theirs[j++]);
+        } else {
+            if (policy == ConflictPolicy::TakeOther) {
+                ours[i]->value = theirs[j]->value;
+            }
+            merged.push_back(ours[i++]);
+            destroyNode(theirs[j++]);
+        }
+    }
+
+    root = linkBalanced(merged, 0, merged.size(), nullptr);
+    treeSize = merged.size();
+    // the dropped duplicates left their keys' slots behind
+    compactKeys();
+    enforceBudget();
+}
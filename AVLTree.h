@@ -4,19 +4,57 @@
 
 #ifndef AVLTREE_H
 #define AVLTREE_H
+#include <functional>
+#include <list>
 #include <optional>
 #include <string>
-#include <bits/stl_vector.h>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "KeyArena.h"
+
+class FrozenAVLTree;
+class GetAwaitable;
+class RangeGenerator;
 
 class AVLTree {
+    friend class FrozenAVLTree;
+
     public:
     using KeyType = std::string;
     using ValueType = size_t;
+    using EntryType = std::pair<KeyType, ValueType>;
+    // called with each entry trimmed to stay within the memory budget
+    using EvictionCallback = std::function<void(const KeyType& key, ValueType value)>;
+
+    // which value wins when merge finds a key in both trees
+    enum class ConflictPolicy { KeepExisting, TakeOther };
+
+    // how FrozenAVLTree stores keys: Eytzinger slots with inline prefixes, or front-coded in sorted order
+    enum class KeyStorage { Plain, FrontCoded };
+
+    struct MemoryUsage {
+        size_t nodeCount;
+        // sizeof(AVLNode) per node, including each key's view into the key arena
+        size_t nodeBytes;
+        // arena bytes occupied by live keys, including size-class rounding
+        size_t keyBytes;
+        // bytes the key arena holds from the allocator: keyBytes plus free and unused space
+        size_t keyArenaBytes;
+        // estimated allocator rounding and bookkeeping of the node allocations
+        size_t allocatorSlack;
+        // estimated recency list and index, only kept while a memory budget is set
+        size_t recencyBytes;
+        // tree object + nodeBytes + keyArenaBytes + allocatorSlack + recencyBytes
+        size_t totalBytes;
+    };
 
     protected:
     class AVLNode {
         public:
-        KeyType key;
+        // bytes live in the owning tree's keyArena
+        std::string_view key;
         ValueType value;
         size_t height;
 
@@ -24,7 +62,7 @@ class AVLTree {
         AVLNode* left;
         AVLNode* right;
 
-        AVLNode(const KeyType& key, ValueType value);
+        AVLNode(std::string_view key, ValueType value);
 
         // 0, 1 or 2
         [[nodiscard]] size_t numChildren() const;
@@ -47,10 +85,30 @@ class AVLTree {
 
     [[nodiscard]] size_t getHeight() const;
 
+    [[nodiscard]] bool isValid() const;
+
     size_t &operator[](const std::string& key);
 
     void operator=(const AVLTree& other);
 
+    void setBackgroundReclaim(bool enabled);
+
+    static void drainBackgroundReclaim();
+
+    void beginIncrementalCopy(const AVLTree& other);
+
+    bool copyStep(size_t maxNodes);
+
+    [[nodiscard]] bool copyInProgress() const;
+
+    void merge(AVLTree&& other, ConflictPolicy policy = ConflictPolicy::KeepExisting);
+
+    [[nodiscard]] MemoryUsage memoryUsage() const;
+
+    void setMemoryBudget(size_t maxBytes, EvictionCallback onEvict = nullptr);
+
+    void clearMemoryBudget();
+
     friend std::ostream& operator<<(std::ostream& os, const AVLTree& tree);
 
     bool insert(const std::string& key, size_t value);
@@ -65,9 +123,47 @@ class AVLTree {
 
     [[nodiscard]] std::vector<std::string> keys() const;
 
+    [[nodiscard]] std::vector<EntryType> prefixScan(const std::string& prefix) const;
+
+    [[nodiscard]] std::optional<EntryType> successor(const std::string& key) const;
+
+    [[nodiscard]] std::optional<EntryType> predecessor(const std::string& key) const;
+
+    [[nodiscard]] std::optional<EntryType> floor(const std::string& key) const;
+
+    [[nodiscard]] std::optional<EntryType> ceiling(const std::string& key) const;
+
+    [[nodiscard]] GetAwaitable getAsync(std::string key) const;
+
+    [[nodiscard]] RangeGenerator rangeAsync(std::string lowKey, std::string highKey, size_t chunkSize) const;
+
+    [[nodiscard]] FrozenAVLTree freeze(KeyStorage storage = KeyStorage::Plain) const;
+
     private:
+    // one source node still waiting to be cloned by copyStep
+    struct PendingCopy {
+        const AVLNode* source;
+        AVLNode* parent;
+        bool isLeft;
+    };
+
     AVLNode* root;
     size_t treeSize;
+    bool backgroundReclaim;
+    std::vector<PendingCopy> pendingCopies;
+    KeyArena keyArena;
+
+    // estimated bytes held by entries, kept current on every node create/destroy
+    size_t trackedBytes;
+    // 0 means no budget
+    size_t memoryBudget;
+    EvictionCallback evictionCallback;
+    // entries by recency for budget eviction, most recent first, and each entry's place
+    // in that list; both stay empty while no budget is set
+    mutable std::list<AVLNode*> recency;
+    mutable std::unordered_map<const AVLNode*, std::list<AVLNode*>::iterator> recencyIndex;
+
+    AVLNode* searchFrom(AVLNode* node, const std::string& searchKey, size_t lowPrefix, size_t highPrefix) const;
 
     static void collectInRange(
         const AVLNode* node,
@@ -78,16 +174,77 @@ class AVLTree {
 
     static void collectKeys(const AVLNode *node, std::vector<std::string> &result);
 
+    static void collectWithPrefix(const AVLNode* node, const std::string& prefix, std::vector<EntryType>& result);
+
+    static void collectEntries(const AVLNode* node, std::vector<EntryType>& result);
+
+    AVLNode* buildFromSorted(const std::vector<EntryType>& sortedEntries, size_t first, size_t last, AVLNode* parent);
+
+    static bool hasPrefix(std::string_view key, const std::string& prefix);
+
+    const AVLNode* lowerBound(const std::string& key, bool inclusive) const;
+
+    const AVLNode* upperBound(const std::string& key, bool inclusive) const;
+
     void printInOrder(std::ostream& os, const AVLNode* node) const;
 
     AVLNode* copy(const AVLNode* node, AVLNode* parent);
 
-    void clear(AVLNode* node);
+    static void clear(AVLNode* node);
+
+    void releaseNodes();
+
+    AVLNode* createNode(std::string_view key, ValueType value);
+
+    void destroyNode(AVLNode* node);
+
+    static size_t nodeFootprint(const AVLNode* node);
+
+    static int checkSubtree(
+        const AVLNode* node,
+        const AVLNode* parent,
+        const AVLNode* low,
+        const AVLNode* high,
+        size_t& count,
+        size_t& bytes
+    );
+
+    void touch(AVLNode* node) const;
+
+    void recencyErase(const AVLNode* node);
+
+    void recencyTransfer(const AVLNode* from, AVLNode* to);
+
+    void rebuildRecency();
+
+    [[nodiscard]] size_t recencyBytes() const;
+
+    static int heightOf(const AVLNode* node);
+
+    static AVLNode* minNode(AVLNode* node);
+
+    static const AVLNode* nextNode(const AVLNode* node);
+
+    static AVLNode* maxNode(AVLNode* node);
+
+    static void collectNodes(AVLNode* node, std::vector<AVLNode*>& result);
+
+    static AVLNode* linkBalanced(const std::vector<AVLNode*>& nodes, size_t first, size_t last, AVLNode* parent);
+
+    AVLNode* adoptNodes(AVLTree& other);
+
+    AVLNode* join(AVLNode* left, AVLNode* pivot, AVLNode* right);
+
+    void enforceBudget();
+
+    void compactKeys();
 
     bool insertNode(AVLNode*& current, AVLNode* parent, const std::string& newKey, size_t value);
 
     bool removeNode(AVLNode*& current);
 
+    void eraseNode(AVLNode* node);
+
     static void updateHeight(AVLNode*& parentNode);
 
     static int getBalance(AVLNode*& parentNode);
@@ -96,11 +253,11 @@ class AVLTree {
 
     static bool replaceChild(AVLNode*& parent, AVLNode*& currentChild, AVLNode*& newChild);
 
-    AVLNode* rotateRight(AVLNode*& node);
+    AVLNode* rotateRight(AVLNode* node);
 
-    AVLNode* rotateLeft(AVLNode*& node);
+    AVLNode* rotateLeft(AVLNode* node);
 
-    AVLNode* rebalanceNode(AVLNode*& node);
+    AVLNode* rebalanceNode(AVLNode* node);
 };
 
 #endif //AVLTREE_H
@@ -0,0 +1,280 @@
+/* Filename: AVLTreeAsync.cpp
+ * Project: Project - AVLTree
+ * Program Description:
+ *    C++20 coroutine front end for AVLTree, meant for single-threaded event loops.
+ *    getAsync completes immediately, rangeAsync yields a scan in bounded chunks so
+ *    long scans can be interleaved with other work, and AVLTreeWriteQueue collects
+ *    writes that one writer task applies in batches between those chunks.
+ *    None of these types lock; all calls must come from the loop's thread.
+ */
+#include "AVLTreeAsync.h"
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+/* Purpose:
+ *    Capture a lookup to run when awaited
+ * Parameters:
+ *    tree – tree to search (must outlive the awaitable)
+ *    key – key to look up (copied, so temporaries are safe)
+ */
+GetAwaitable::GetAwaitable(const AVLTree& tree, std::string key) : tree(tree), key(std::move(key)) {}
+
+/* Purpose:
+ *    A point lookup is O(log n) and never blocks, so the awaiting coroutine keeps running
+ * Returns:
+ *    always true
+ */
+bool GetAwaitable::await_ready() const noexcept {
+    return true;
+}
+
+/* Purpose:
+ *    Never called because await_ready is always true
+ */
+void GetAwaitable::await_suspend(coroutine_handle<>) const noexcept {}
+
+/* Purpose:
+ *    Perform the lookup
+ * Returns:
+ *    optional<size_t> containing the value if found; nullopt otherwise
+ */
+optional<size_t> GetAwaitable::await_resume() const {
+    return tree.get(key);
+}
+
+/* Purpose:
+ *    Awaitable point lookup: co_await tree.getAsync(key)
+ * Parameters:
+ *    key – key to look up
+ * Returns:
+ *    GetAwaitable producing optional<size_t>
+ */
+GetAwaitable AVLTree::getAsync(std::string key) const {
+    return {*this, std::move(key)};
+}
+
+/* Purpose:
+ *    Coroutine that scans [lowKey, highKey] and yields up to chunkSize entries at a time
+ * Parameters:
+ *    lowKey, highKey – inclusive bounds (taken by value; they live in the coroutine frame)
+ *    chunkSize – maximum entries per chunk (0 is treated as 1)
+ * Returns:
+ *    RangeGenerator; nothing is scanned until its first next()
+ * Behavior:
+ *    Each chunk starts with a fresh O(log n) descent from the last key yielded, so the
+ *    tree may be modified between chunks. Entries changed behind the cursor are not
+ *    revisited; entries inserted ahead of it are picked up. The tree must outlive the generator
+ */
+RangeGenerator AVLTree::rangeAsync(std::string lowKey, std::string highKey, size_t chunkSize) const {
+    if (chunkSize == 0) {
+        chunkSize = 1;
+    }
+
+    const AVLNode* node = lowerBound(lowKey, true);
+    while (node && node->key <= highKey) {
+        RangeGenerator::ChunkType chunk;
+        chunk.reserve(chunkSize);
+        while (node && node->key <= highKey && chunk.size() < chunkSize) {
+            chunk.emplace_back(node->key, node->value);
+            node = nextNode(node);
+        }
+
+        const KeyType lastKey = chunk.back().first;
+        co_yield std::move(chunk);
+        node = lowerBound(lastKey, false);
+    }
+}
+
+/* Purpose:
+ *    Create the generator object that owns this coroutine
+ */
+RangeGenerator RangeGenerator::promise_type::get_return_object() {
+    return RangeGenerator(coroutine_handle<promise_type>::from_promise(*this));
+}
+
+/* Purpose:
+ *    Store a produced chunk and suspend until the caller asks for the next one
+ */
+suspend_always RangeGenerator::promise_type::yield_value(ChunkType chunk) {
+    current = std::move(chunk);
+    return {};
+}
+
+/* Purpose:
+ *    Remember an exception from the scan so next() can rethrow it to the caller
+ */
+void RangeGenerator::promise_type::unhandled_exception() {
+    error = current_exception();
+}
+
+RangeGenerator::RangeGenerator(coroutine_handle<promise_type> handle) : handle(handle) {}
+
+RangeGenerator::RangeGenerator(RangeGenerator&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+RangeGenerator::~RangeGenerator() {
+    if (handle) {
+        handle.destroy();
+    }
+}
+
+/* Purpose:
+ *    Run the scan until it yields its next chunk
+ * Returns:
+ *    true if chunk() now holds new entries, false if the range is exhausted
+ */
+bool RangeGenerator::next() {
+    if (!handle || handle.done()) {
+        return false;
+    }
+    handle.resume();
+    if (handle.promise().error) {
+        rethrow_exception(std::exchange(handle.promise().error, nullptr));
+    }
+    return !handle.done();
+}
+
+/* Purpose:
+ *    Access the chunk produced by the last successful next()
+ */
+const RangeGenerator::ChunkType& RangeGenerator::chunk() const {
+    return handle.promise().current;
+}
+
+/* Purpose:
+ *    Create the task object that owns this coroutine
+ */
+WriterTask WriterTask::promise_type::get_return_object() {
+    return WriterTask(coroutine_handle<promise_type>::from_promise(*this));
+}
+
+/* Purpose:
+ *    Remember an exception from a write so step() can rethrow it to the caller
+ */
+void WriterTask::promise_type::unhandled_exception() {
+    error = current_exception();
+}
+
+WriterTask::WriterTask(coroutine_handle<promise_type> handle) : handle(handle) {}
+
+WriterTask::WriterTask(WriterTask&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+WriterTask::~WriterTask() {
+    if (handle) {
+        handle.destroy();
+    }
+}
+
+/* Purpose:
+ *    Resume the writer for one batch
+ * Returns:
+ *    true while the writer is still running, false once it has finished
+ */
+bool WriterTask::step() {
+    if (!handle || handle.done()) {
+        return false;
+    }
+    handle.resume();
+    if (handle.promise().error) {
+        rethrow_exception(std::exchange(handle.promise().error, nullptr));
+    }
+    return !handle.done();
+}
+
+/* Purpose:
+ *    Create an empty, open write queue for tree
+ * Parameters:
+ *    tree – tree the writes apply to (must outlive the queue and its writer task)
+ */
+AVLTreeWriteQueue::AVLTreeWriteQueue(AVLTree& tree) : tree(tree) {
+    closed = false;
+}
+
+/* Purpose:
+ *    Queue an insert; like AVLTree::insert it does not replace an existing key
+ */
+void AVLTreeWriteQueue::insert(std::string key, size_t value) {
+    if (closed) return;
+    writes.push_back({WriteKind::Insert, std::move(key), value});
+}
+
+/* Purpose:
+ *    Queue an upsert: insert the key, or overwrite its value if present
+ */
+void AVLTreeWriteQueue::assign(std::string key, size_t value) {
+    if (closed) return;
+    writes.push_back({WriteKind::Assign, std::move(key), value});
+}
+
+/* Purpose:
+ *    Queue a removal
+ */
+void AVLTreeWriteQueue::remove(std::string key) {
+    if (closed) return;
+    writes.push_back({WriteKind::Remove, std::move(key), 0});
+}
+
+/* Purpose:
+ *    Stop accepting new writes; already queued writes are still applied
+ */
+void AVLTreeWriteQueue::close() {
+    closed = true;
+}
+
+/* Purpose:
+ *    Number of writes waiting to be applied
+ */
+size_t AVLTreeWriteQueue::pending() const {
+    return writes.size();
+}
+
+/* Purpose:
+ *    Apply up to maxWrites queued writes in submission order
+ * Parameters:
+ *    maxWrites – upper bound on writes applied by this call
+ * Returns:
+ *    number of writes applied
+ */
+size_t AVLTreeWriteQueue::applyBatch(size_t maxWrites) {
+    size_t applied = 0;
+    while (applied < maxWrites && !writes.empty()) {
+        PendingWrite write = std::move(writes.front());
+        writes.pop_front();
+        switch (write.kind) {
+            case WriteKind::Insert:
+                tree.insert(write.key, write.value);
+                break;
+            case WriteKind::Assign:
+                if (!tree.insert(write.key, write.value)) {
+                    tree[write.key] = write.value;
+                }
+                break;
+            case WriteKind::Remove:
+                tree.remove(write.key);
+                break;
+        }
+        applied++;
+    }
+    return applied;
+}
+
+/* Purpose:
+ *    Single writer coroutine for this queue
+ * Parameters:
+ *    batchSize – maximum writes applied per step
+ * Returns:
+ *    WriterTask; the event loop calls step() once per tick
+ * Behavior:
+ *    Each step applies at most one batch and then yields back to the loop, so readers
+ *    and range scans run between batches. Finishes after close() once the queue is empty
+ */
+WriterTask AVLTreeWriteQueue::run(size_t batchSize) {
+    while (!closed || !writes.empty()) {
+        applyBatch(batchSize);
+        co_await suspend_always{};
+    }
+}
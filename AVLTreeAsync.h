@@ -0,0 +1,131 @@
+/*
+ * AVLTreeAsync.h
+ */
+
+#ifndef AVLTREEASYNC_H
+#define AVLTREEASYNC_H
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <string>
+#include <vector>
+#include "AVLTree.h"
+
+// result of AVLTree::getAsync; a point lookup is short, so it completes without suspending
+class GetAwaitable {
+    public:
+    GetAwaitable(const AVLTree& tree, std::string key);
+
+    [[nodiscard]] bool await_ready() const noexcept;
+
+    void await_suspend(std::coroutine_handle<>) const noexcept;
+
+    std::optional<size_t> await_resume() const;
+
+    private:
+    const AVLTree& tree;
+    std::string key;
+};
+
+// lazily produces a range scan in chunks; each next() does one chunk of work
+class RangeGenerator {
+    public:
+    using ChunkType = std::vector<AVLTree::EntryType>;
+
+    struct promise_type {
+        ChunkType current;
+        std::exception_ptr error;
+
+        RangeGenerator get_return_object();
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(ChunkType chunk);
+        void return_void() {}
+        void unhandled_exception();
+    };
+
+    RangeGenerator(RangeGenerator&& other) noexcept;
+
+    RangeGenerator(const RangeGenerator&) = delete;
+
+    RangeGenerator& operator=(const RangeGenerator&) = delete;
+
+    ~RangeGenerator();
+
+    // produce the next chunk; false once the range is exhausted
+    bool next();
+
+    [[nodiscard]] const ChunkType& chunk() const;
+
+    private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit RangeGenerator(std::coroutine_handle<promise_type> handle);
+};
+
+// long-lived writer coroutine; each step() applies one batch of queued writes
+class WriterTask {
+    public:
+    struct promise_type {
+        std::exception_ptr error;
+
+        WriterTask get_return_object();
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception();
+    };
+
+    WriterTask(WriterTask&& other) noexcept;
+
+    WriterTask(const WriterTask&) = delete;
+
+    WriterTask& operator=(const WriterTask&) = delete;
+
+    ~WriterTask();
+
+    // run one batch; false once the queue is closed and drained
+    bool step();
+
+    private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit WriterTask(std::coroutine_handle<promise_type> handle);
+};
+
+// queue of pending writes to one tree, applied in batches by a single writer task
+class AVLTreeWriteQueue {
+    public:
+    explicit AVLTreeWriteQueue(AVLTree& tree);
+
+    void insert(std::string key, size_t value);
+
+    void assign(std::string key, size_t value);
+
+    void remove(std::string key);
+
+    // stop accepting writes; the writer task finishes once the queue is empty
+    void close();
+
+    [[nodiscard]] size_t pending() const;
+
+    size_t applyBatch(size_t maxWrites);
+
+    WriterTask run(size_t batchSize);
+
+    private:
+    enum class WriteKind { Insert, Assign, Remove };
+
+    struct PendingWrite {
+        WriteKind kind;
+        std::string key;
+        size_t value;
+    };
+
+    AVLTree& tree;
+    std::deque<PendingWrite> writes;
+    bool closed;
+};
+
+#endif //AVLTREEASYNC_H
@@ -0,0 +1,95 @@
+/*
+Benchmark for key storage layouts.
+Builds an AVLTree from URL-like keys that share long prefixes, then reports
+bytes per key and average lookup latency for the mutable tree and for
+frozen snapshots with plain and front-coded key storage.
+Usage: AVLTreeBench [keyCount] [lookupCount]
+ */
+#include "AVLTree.h"
+#include "FrozenAVLTree.h"
+#include "KeyCompare.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+/* Purpose:
+ *    Generate count distinct hierarchical keys such as
+ *    "https://cdn.example.com/assets/region-3/bucket-17/object-000123456.json"
+ */
+vector<string> makeKeys(size_t count, mt19937_64& rng) {
+    vector<string> keys;
+    keys.reserve(count);
+    char buffer[128];
+    for (size_t i = 0; i < count; i++) {
+        snprintf(buffer, sizeof(buffer),
+                 "https://cdn.example.com/assets/region-%u/bucket-%u/object-%09zu.json",
+                 static_cast<unsigned>(rng() % 8),
+                 static_cast<unsigned>(rng() % 64),
+                 i);
+        keys.emplace_back(buffer);
+    }
+    return keys;
+}
+
+/* Purpose:
+ *    Time lookup() over the probe keys and return the average nanoseconds per call
+ */
+template <typename Lookup>
+double nanosPerLookup(const vector<string>& probes, Lookup lookup) {
+    size_t found = 0;
+    const auto start = chrono::steady_clock::now();
+    for (const string& key : probes) {
+        found += lookup(key) ? 1 : 0;
+    }
+    const auto elapsed = chrono::steady_clock::now() - start;
+    if (found != probes.size()) {
+        cerr << "lookup missed " << probes.size() - found << " keys" << endl;
+    }
+    return static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(elapsed).count()) / probes.size();
+}
+
+int main(int argc, char* argv[]) {
+    const size_t keyCount = argc > 1 ? stoul(argv[1]) : 200000;
+    const size_t lookupCount = argc > 2 ? stoul(argv[2]) : 1000000;
+
+    mt19937_64 rng(42);
+    const vector<string> keys = makeKeys(keyCount, rng);
+    size_t keyBytes = 0;
+    for (const string& key : keys) {
+        keyBytes += key.size();
+    }
+
+    AVLTree tree;
+    for (size_t i = 0; i < keys.size(); i++) {
+        tree.insert(keys[i], i);
+    }
+    const FrozenAVLTree plain = tree.freeze(AVLTree::KeyStorage::Plain);
+    const FrozenAVLTree frontCoded = tree.freeze(AVLTree::KeyStorage::FrontCoded);
+
+    vector<string> probes;
+    probes.reserve(lookupCount);
+    for (size_t i = 0; i < lookupCount; i++) {
+        probes.push_back(keys[rng() % keys.size()]);
+    }
+
+    cout << "keys: " << keyCount << ", average key length: "
+         << static_cast<double>(keyBytes) / keyCount << " bytes, compare kernel: "
+         << keyCompareKernel() << endl;
+    cout << "layout                bytes/key    ns/lookup" << endl;
+
+    const double treeNanos = nanosPerLookup(probes, [&](const string& key) { return tree.get(key); });
+    const double plainNanos = nanosPerLookup(probes, [&](const string& key) { return plain.get(key); });
+    const double frontNanos = nanosPerLookup(probes, [&](const string& key) { return frontCoded.get(key); });
+
+    printf("AVLTree            %12.1f %12.1f\n",
+           static_cast<double>(tree.memoryUsage().totalBytes) / keyCount, treeNanos);
+    printf("frozen plain       %12.1f %12.1f\n",
+           static_cast<double>(plain.memoryUsage()) / keyCount, plainNanos);
+    printf("frozen front-coded %12.1f %12.1f\n",
+           static_cast<double>(frontCoded.memoryUsage()) / keyCount, frontNanos);
+    return 0;
+}
@@ -0,0 +1,515 @@
+/*
+Randomized consistency checks for AVLTree.
+Every operation is mirrored on a std::map and the results compared, with
+AVLTree::isValid() run along the way. main() runs one section per feature,
+each for the given number of rounds with consecutive seeds.
+Usage: AVLTreeCheck [seed] [rounds]
+Prints each failed check with the seed that reproduces it; exits non-zero
+if any check failed.
+ */
+#include "AVLTree.h"
+#include "AVLTreeAsync.h"
+#include "FrozenAVLTree.h"
+#include "KeyArena.h"
+#include <algorithm>
+#include <coroutine>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+using Model = map<string, size_t>;
+
+size_t failures = 0;
+uint64_t currentSeed = 0;
+
+/* Purpose:
+ *    Record a failed check together with the seed of the round it happened in
+ */
+void check(bool ok, const string& what) {
+    if (ok) return;
+    failures++;
+    if (failures <= 20) {
+        cout << "FAILED: " << what << " (seed " << currentSeed << ")" << endl;
+    }
+}
+
+/* Purpose:
+ *    Random key over a three-letter alphabet, so prefixes and near misses are common.
+ *    Includes the empty key and, rarely, keys long enough to bypass the key arena's chunks
+ */
+string randomKey(mt19937_64& rng) {
+    const size_t kind = rng() % 50;
+    size_t length = 1 + rng() % 8;
+    if (kind == 0) {
+        length = 0;
+    } else if (kind == 1) {
+        length = 1100 + rng() % 200;
+    }
+    string key(length, 'a');
+    for (size_t i = 0; i < length; i++) {
+        // long keys share most of their bytes so they collide with each other
+        key[i] = static_cast<char>(length > 64 && i < length - 4 ? 'b' : 'a' + rng() % 3);
+    }
+    return key;
+}
+
+Model::const_iterator modelFloor(const Model& model, const string& key) {
+    auto found = model.upper_bound(key);
+    return found == model.begin() ? model.end() : prev(found);
+}
+
+Model::const_iterator modelBelow(const Model& model, const string& key) {
+    auto found = model.lower_bound(key);
+    return found == model.begin() ? model.end() : prev(found);
+}
+
+/* Purpose:
+ *    Compare a tree's optional entry result against a model iterator
+ */
+bool sameEntry(const optional<AVLTree::EntryType>& actual, const Model& model, Model::const_iterator expected) {
+    if (expected == model.end()) return !actual.has_value();
+    return actual && actual->first == expected->first && actual->second == expected->second;
+}
+
+vector<AVLTree::EntryType> entriesOf(const Model& model) {
+    return {model.begin(), model.end()};
+}
+
+vector<size_t> valuesInRange(const Model& model, const string& lowKey, const string& highKey) {
+    vector<size_t> values;
+    for (auto it = model.lower_bound(lowKey); it != model.end() && it->first <= highKey; ++it) {
+        values.push_back(it->second);
+    }
+    return values;
+}
+
+vector<AVLTree::EntryType> entriesWithPrefix(const Model& model, const string& prefix) {
+    vector<AVLTree::EntryType> result;
+    for (auto it = model.lower_bound(prefix); it != model.end() && it->first.starts_with(prefix); ++it) {
+        result.push_back(*it);
+    }
+    return result;
+}
+
+/* Purpose:
+ *    Fill tree and model with up to count random entries
+ */
+void populate(AVLTree& tree, Model& model, size_t count, mt19937_64& rng, const string& prefix = "") {
+    for (size_t i = 0; i < count; i++) {
+        const string key = prefix + randomKey(rng);
+        const size_t value = rng();
+        if (tree.insert(key, value)) {
+            model.emplace(key, value);
+        }
+    }
+}
+
+/* Purpose:
+ *    Random mix of updates and queries; rotations and every removal case are hit
+ *    because the key space is small enough for keys to be removed and reinserted often
+ */
+void checkOperations(mt19937_64& rng) {
+    AVLTree tree;
+    Model model;
+    for (size_t step = 0; step < 4000; step++) {
+        const string key = randomKey(rng);
+        switch (rng() % 10) {
+            case 0:
+            case 1:
+            case 2: {
+                const size_t value = rng();
+                const bool inserted = tree.insert(key, value);
+                check(inserted == !model.count(key), "insert result for " + key);
+                if (inserted) model.emplace(key, value);
+                break;
+            }
+            case 3:
+            case 4:
+                check(tree.remove(key) == (model.erase(key) > 0), "remove result for " + key);
+                break;
+            case 5: {
+                const auto found = model.find(key);
+                const optional<size_t> value = tree.get(key);
+                check(tree.contains(key) == (found != model.end()), "contains " + key);
+                check(found == model.end() ? !value : value == found->second, "get " + key);
+                if (found != model.end()) {
+                    tree[key] = step;
+                    model[key] = step;
+                }
+                break;
+            }
+            case 6: {
+                string lowKey = randomKey(rng);
+                string highKey = randomKey(rng);
+                if (highKey < lowKey) swap(lowKey, highKey);
+                check(tree.findRange(lowKey, highKey) == valuesInRange(model, lowKey, highKey),
+                      "findRange [" + lowKey + ", " + highKey + "]");
+                break;
+            }
+            case 7: {
+                const string prefix = key.substr(0, rng() % 3);
+                check(tree.prefixScan(prefix) == entriesWithPrefix(model, prefix), "prefixScan " + prefix);
+                break;
+            }
+            default:
+                check(sameEntry(tree.successor(key), model, model.upper_bound(key)), "successor " + key);
+                check(sameEntry(tree.predecessor(key), model, modelBelow(model, key)), "predecessor " + key);
+                check(sameEntry(tree.floor(key), model, modelFloor(model, key)), "floor " + key);
+                check(sameEntry(tree.ceiling(key), model, model.lower_bound(key)), "ceiling " + key);
+                break;
+        }
+        check(tree.size() == model.size(), "size after step " + to_string(step));
+        if (step % 250 == 0) {
+            check(tree.isValid(), "invariants after step " + to_string(step));
+        }
+    }
+    check(tree.isValid(), "invariants after random operations");
+    check(tree.prefixScan("") == entriesOf(model), "final contents");
+}
+
+/* Purpose:
+ *    Freeze in both key storages and compare every query with the tree; thaw back
+ */
+void checkSnapshots(mt19937_64& rng) {
+    AVLTree tree;
+    Model model;
+    populate(tree, model, rng() % 2000, rng);
+    vector<string> keys;
+    for (const auto& [key, value] : model) {
+        keys.push_back(key);
+    }
+    check(tree.keys() == keys, "keys before freeze");
+
+    for (const AVLTree::KeyStorage storage : {AVLTree::KeyStorage::Plain, AVLTree::KeyStorage::FrontCoded}) {
+        const string name = storage == AVLTree::KeyStorage::Plain ? "plain" : "front-coded";
+        const FrozenAVLTree frozen = tree.freeze(storage);
+        check(frozen.keyStorage() == storage, name + " storage");
+        check(frozen.size() == model.size(), name + " size");
+        check(frozen.keys() == keys, name + " keys");
+        for (const auto& [key, value] : model) {
+            check(frozen.get(key) == value, name + " get " + key);
+        }
+        for (size_t probe = 0; probe < 500; probe++) {
+            const string key = randomKey(rng);
+            check(frozen.contains(key) == (model.count(key) > 0), name + " contains " + key);
+            string lowKey = key;
+            string highKey = randomKey(rng);
+            if (highKey < lowKey) swap(lowKey, highKey);
+            check(frozen.findRange(lowKey, highKey) == valuesInRange(model, lowKey, highKey),
+                  name + " findRange [" + lowKey + ", " + highKey + "]");
+        }
+        const AVLTree thawed = frozen.thaw();
+        check(thawed.isValid(), name + " thaw invariants");
+        check(thawed.prefixScan("") == entriesOf(model), name + " thaw contents");
+    }
+}
+
+/* Purpose:
+ *    Copy a tree in bounded steps, by assignment and by copy construction, and check
+ *    each copy is independent of its source
+ */
+void checkCopies(mt19937_64& rng) {
+    AVLTree source;
+    Model model;
+    populate(source, model, rng() % 1500, rng);
+
+    AVLTree target;
+    Model ignored;
+    populate(target, ignored, rng() % 500, rng);
+    target.setBackgroundReclaim(rng() % 2);
+    const bool budgeted = rng() % 3 == 0;
+    if (budgeted) target.setMemoryBudget(size_t{1} << 40);
+    target.beginIncrementalCopy(source);
+    while (!target.copyStep(1 + rng() % 64)) {
+        check(target.copyInProgress(), "copyInProgress during copy");
+    }
+    check(!target.copyInProgress(), "copyInProgress after copy");
+    check(target.isValid(), "incremental copy invariants");
+    check(target.prefixScan("") == entriesOf(model), "incremental copy contents");
+
+    AVLTree assigned;
+    assigned.setBackgroundReclaim(rng() % 2);
+    populate(assigned, ignored, rng() % 500, rng);
+    assigned = source;
+    const AVLTree constructed(source);
+    check(assigned.isValid() && constructed.isValid(), "copy invariants");
+
+    for (size_t step = 0; step < 200; step++) {
+        source.remove(randomKey(rng));
+        source.insert(randomKey(rng), step);
+    }
+    check(target.prefixScan("") == entriesOf(model), "incremental copy independent of source");
+    check(assigned.prefixScan("") == entriesOf(model), "assigned copy independent of source");
+    check(constructed.prefixScan("") == entriesOf(model), "constructed copy independent of source");
+    check(source.isValid(), "source invariants after edits");
+
+    // the copy is ranked by key as it is built, so tightening the budget evicts in key order
+    if (budgeted && model.size() > 1) {
+        vector<string> evicted;
+        const AVLTree::MemoryUsage usage = target.memoryUsage();
+        target.setMemoryBudget((usage.nodeBytes + usage.allocatorSlack + usage.keyBytes) / 2,
+                               [&evicted](const string& key, size_t) { evicted.push_back(key); });
+        auto expected = model.begin();
+        for (const string& key : evicted) {
+            check(expected != model.end() && expected->first == key, "copy evicts in key order, evicted " + key);
+            if (expected != model.end()) ++expected;
+        }
+        check(!evicted.empty() && target.isValid(), "tightened budget trims the copy");
+    }
+}
+
+/* Purpose:
+ *    Run a bounded cache and check every eviction against an exact LRU model
+ */
+void checkBudget(mt19937_64& rng) {
+    AVLTree tree;
+    Model model;
+    // most recently used at the front
+    list<string> recency;
+    vector<string> evicted;
+    tree.setMemoryBudget(4096 + rng() % 16384, [&evicted](const string& key, size_t) {
+        evicted.push_back(key);
+    });
+
+    const auto use = [&recency](const string& key) {
+        recency.remove(key);
+        recency.push_front(key);
+    };
+    for (size_t step = 0; step < 3000; step++) {
+        const string key = randomKey(rng);
+        evicted.clear();
+        switch (rng() % 4) {
+            case 0:
+                check(tree.remove(key) == (model.erase(key) > 0), "budget remove " + key);
+                recency.remove(key);
+                break;
+            case 1: {
+                const optional<size_t> value = tree.get(key);
+                check(value.has_value() == (model.count(key) > 0), "budget get " + key);
+                if (value) use(key);
+                break;
+            }
+            default:
+                if (tree.insert(key, step)) {
+                    check(!model.count(key), "budget insert of existing " + key);
+                    model.emplace(key, step);
+                    use(key);
+                }
+                for (const string& victim : evicted) {
+                    check(!recency.empty() && recency.back() == victim, "eviction order, evicted " + victim);
+                    if (recency.empty()) break;
+                    model.erase(recency.back());
+                    recency.pop_back();
+                }
+                break;
+        }
+        check(tree.size() == model.size(), "budget size after step " + to_string(step));
+        if (step % 250 == 0) {
+            check(tree.isValid(), "budget invariants after step " + to_string(step));
+        }
+    }
+    check(tree.prefixScan("") == entriesOf(model), "budget contents");
+
+    // a budget set on an existing tree ranks entries by key, smallest least recently used
+    AVLTree unbounded;
+    Model all;
+    populate(unbounded, all, 200 + rng() % 300, rng);
+    evicted.clear();
+    const AVLTree::MemoryUsage usage = unbounded.memoryUsage();
+    const size_t entryBytes = usage.nodeBytes + usage.allocatorSlack + usage.keyBytes;
+    unbounded.setMemoryBudget(entryBytes / 2, [&evicted](const string& key, size_t) {
+        evicted.push_back(key);
+    });
+    auto expected = all.begin();
+    for (const string& key : evicted) {
+        check(expected != all.end() && expected->first == key, "new budget evicts in key order, evicted " + key);
+        if (expected != all.end()) ++expected;
+    }
+    check(!evicted.empty() && unbounded.isValid(), "new budget trims the tree");
+    unbounded.clearMemoryBudget();
+    check(unbounded.isValid(), "invariants after clearing the budget");
+}
+
+/* Purpose:
+ *    Merge trees with disjoint and overlapping key ranges under both conflict policies
+ */
+void checkMerge(mt19937_64& rng) {
+    AVLTree tree;
+    AVLTree other;
+    Model model;
+    Model otherModel;
+    const bool disjoint = rng() % 2;
+    const size_t sizes[] = {0, 1, 5, 50, 500};
+    populate(tree, model, sizes[rng() % 5], rng, disjoint ? "a" : "");
+    populate(other, otherModel, sizes[rng() % 5], rng, disjoint ? (rng() % 2 ? "b" : "") : "");
+    if (rng() % 3 == 0) tree.setMemoryBudget(size_t{1} << 40);
+    if (rng() % 3 == 0) other.setMemoryBudget(size_t{1} << 40);
+
+    const bool takeOther = rng() % 2;
+    for (const auto& [key, value] : otherModel) {
+        if (takeOther) {
+            model[key] = value;
+        } else {
+            model.emplace(key, value);
+        }
+    }
+    tree.merge(std::move(other), takeOther ? AVLTree::ConflictPolicy::TakeOther : AVLTree::ConflictPolicy::KeepExisting);
+    check(tree.isValid(), "merge invariants");
+    check(tree.prefixScan("") == entriesOf(model), "merge contents");
+    check(other.size() == 0 && other.isValid(), "merge leaves other empty");
+
+    // the merged tree must keep working, including on the adopted keys
+    for (size_t step = 0; step < 200; step++) {
+        const string key = randomKey(rng);
+        check(tree.remove(key) == (model.erase(key) > 0), "remove after merge " + key);
+    }
+    check(tree.isValid(), "invariants after removing from merged tree");
+    check(tree.prefixScan("") == entriesOf(model), "contents after removing from merged tree");
+}
+
+// minimal fire-and-forget coroutine so getAsync can be co_awaited from a test
+struct CheckTask {
+    struct promise_type {
+        CheckTask get_return_object() { return {}; }
+        suspend_never initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+};
+
+CheckTask awaitLookups(const AVLTree& tree, const vector<string>& keys, vector<optional<size_t>>& results) {
+    for (const string& key : keys) {
+        results.push_back(co_await tree.getAsync(key));
+    }
+}
+
+/* Purpose:
+ *    getAsync, chunked rangeAsync and the batched write queue against the model
+ */
+void checkAsync(mt19937_64& rng) {
+    AVLTree tree;
+    Model model;
+    populate(tree, model, rng() % 1000, rng);
+
+    vector<string> probes;
+    for (size_t i = 0; i < 200; i++) {
+        probes.push_back(randomKey(rng));
+    }
+    vector<optional<size_t>> results;
+    awaitLookups(tree, probes, results);
+    for (size_t i = 0; i < probes.size(); i++) {
+        const auto found = model.find(probes[i]);
+        check(found == model.end() ? !results[i] : results[i] == found->second, "getAsync " + probes[i]);
+    }
+
+    string lowKey = randomKey(rng);
+    string highKey = randomKey(rng);
+    if (highKey < lowKey) swap(lowKey, highKey);
+    const size_t chunkSize = rng() % 20;
+    RangeGenerator range = tree.rangeAsync(lowKey, highKey, chunkSize);
+    vector<size_t> scanned;
+    while (range.next()) {
+        check(range.chunk().size() <= max<size_t>(chunkSize, 1), "rangeAsync chunk size");
+        for (const AVLTree::EntryType& entry : range.chunk()) {
+            scanned.push_back(entry.second);
+        }
+    }
+    check(scanned == valuesInRange(model, lowKey, highKey), "rangeAsync [" + lowKey + ", " + highKey + "]");
+
+    AVLTreeWriteQueue queue(tree);
+    WriterTask writer = queue.run(1 + rng() % 16);
+    for (size_t i = 0; i < 500; i++) {
+        const string key = randomKey(rng);
+        switch (rng() % 3) {
+            case 0:
+                queue.insert(key, i);
+                model.emplace(key, i);
+                break;
+            case 1:
+                queue.assign(key, i);
+                model[key] = i;
+                break;
+            default:
+                queue.remove(key);
+                model.erase(key);
+                break;
+        }
+        if (rng() % 4 == 0) {
+            writer.step();
+        }
+    }
+    queue.close();
+    while (writer.step()) {}
+    check(queue.pending() == 0, "write queue drained");
+    check(tree.isValid(), "write queue invariants");
+    check(tree.prefixScan("") == entriesOf(model), "write queue contents");
+}
+
+/* Purpose:
+ *    Run a bounded cache whose key lengths drift up past LargeKey and back down, and
+ *    check the key arena's slots for older lengths do not pile up beyond the budget
+ */
+void checkKeyArena(mt19937_64& rng) {
+    AVLTree tree;
+    const size_t budget = size_t{1} << 20;
+    tree.setMemoryBudget(budget);
+    for (size_t phase = 0; phase < 24; phase++) {
+        const size_t shortest = 1 + (phase < 12 ? phase : 23 - phase) * 100;
+        vector<string> inserted;
+        for (size_t step = 0; step < 1000; step++) {
+            if (!inserted.empty() && rng() % 4 == 0) {
+                tree.remove(inserted[rng() % inserted.size()]);
+                continue;
+            }
+            string key(shortest + rng() % 64, 'a');
+            for (char& c : key) {
+                c = static_cast<char>('a' + rng() % 26);
+            }
+            tree.insert(key, step);
+            inserted.push_back(key);
+        }
+        const AVLTree::MemoryUsage usage = tree.memoryUsage();
+        check(usage.totalBytes <= budget + budget / 8 + KeyArena::ChunkSize,
+              "memory near budget after phase " + to_string(phase) + ": " + to_string(usage.totalBytes));
+        check(tree.isValid(), "invariants after phase " + to_string(phase));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const uint64_t firstSeed = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1;
+    const size_t rounds = argc > 2 ? strtoull(argv[2], nullptr, 10) : 20;
+
+    const pair<const char*, void (*)(mt19937_64&)> sections[] = {
+        {"operations", checkOperations},
+        {"freeze/thaw", checkSnapshots},
+        {"copy", checkCopies},
+        {"budget", checkBudget},
+        {"merge", checkMerge},
+        {"async", checkAsync},
+        {"key arena", checkKeyArena},
+    };
+    for (const auto& [name, run] : sections) {
+        const size_t before = failures;
+        for (size_t round = 0; round < rounds; round++) {
+            currentSeed = firstSeed + round;
+            mt19937_64 rng(currentSeed);
+            run(rng);
+        }
+        cout << name << ": " << (failures == before ? "ok" : "FAILED") << endl;
+    }
+    AVLTree::drainBackgroundReclaim();
+
+    cout << failures << " failed checks" << endl;
+    return failures == 0 ? 0 : 1;
+}
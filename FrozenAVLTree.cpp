@@ -0,0 +1,582 @@
+/* Filename: FrozenAVLTree.cpp
+ * Project: Project - AVLTree
+ * Program Description:
+ *    Immutable, read-optimised snapshot of an AVLTree. Entries are laid out in a
+ *    single array in Eytzinger (breadth-first) order so a lookup walks the array
+ *    top-down with no pointer chasing, and the first few levels stay hot in cache.
+ *    The prefix shared by all keys is stored once. Each 16-byte slot holds 8 key bytes
+ *    inline, taken from where the keys around it start to differ (the common prefix of
+ *    its two bounding ancestors), so most steps of a descent never leave the slot array
+ *    and only ties on those 8 bytes read the rest of the key from a shared arena.
+ *    Supports the same get/contains/findRange queries as AVLTree, and thaw()
+ *    converts the snapshot back into a mutable tree.
+ *    In front-coded mode keys are instead kept in sorted order in one byte arena,
+ *    each storing only the suffix that differs from the previous key, in blocks of
+ *    FrontCodedBlockSize whose first key is stored in full. Lookups binary search the
+ *    block heads and then decode at most one block.
+ */
+#include "FrozenAVLTree.h"
+#include "KeyCompare.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+namespace {
+
+/* Purpose:
+ *    Append value to arena as a LEB128 varint (7 bits per byte, high bit = more follows)
+ */
+void writeVarint(vector<char>& arena, size_t value) {
+    while (value >= 0x80) {
+        arena.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    arena.push_back(static_cast<char>(value));
+}
+
+/* Purpose:
+ *    Read a LEB128 varint starting at offset
+ * Returns:
+ *    decoded value; offset is advanced past it
+ */
+size_t readVarint(const vector<char>& arena, size_t& offset) {
+    size_t value = 0;
+    int shift = 0;
+    while (true) {
+        const auto byte = static_cast<unsigned char>(arena[offset++]);
+        value |= static_cast<size_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+        shift += 7;
+    }
+}
+
+} // namespace
+
+/* Purpose:
+ *    Construct an empty frozen index
+ */
+FrozenAVLTree::FrozenAVLTree() {
+    storage = KeyStorage::Plain;
+    eytzSlots.resize(1);
+    eytzValues.resize(1);
+    treeSize = 0;
+}
+
+/* Purpose:
+ *    Build a frozen index from entries already sorted by key
+ * Parameters:
+ *    sortedEntries – (key, value) pairs in strictly ascending key order
+ *    storage – Plain or FrontCoded key layout
+ * Behavior:
+ *    Plain allocates n + 1 slots (slot 0 unused) and places entries in Eytzinger order.
+ *    Throws length_error if the key bytes do not fit the 32-bit arena offsets
+ */
+FrozenAVLTree::FrozenAVLTree(const vector<EntryType>& sortedEntries, KeyStorage storage) {
+    this->storage = storage;
+    treeSize = sortedEntries.size();
+    if (storage == KeyStorage::FrontCoded) {
+        buildFrontCoded(sortedEntries);
+        return;
+    }
+    if (treeSize > 0) {
+        const string& first = sortedEntries.front().first;
+        const string& last = sortedEntries.back().first;
+        commonPrefix = first.substr(0, compareKeys(first, last).mismatch);
+    }
+    size_t arenaBytes = 0;
+    for (const EntryType& entry : sortedEntries) {
+        const size_t suffixLength = entry.first.size() - commonPrefix.size();
+        arenaBytes += suffixLength + (suffixLength >= LongKey ? sizeof(uint32_t) : 0);
+    }
+    if (arenaBytes > numeric_limits<uint32_t>::max()) {
+        throw length_error("FrozenAVLTree: key bytes exceed 4 GiB");
+    }
+    keyArena.reserve(arenaBytes);
+
+    eytzSlots.resize(treeSize + 1);
+    eytzValues.resize(treeSize + 1);
+    size_t next = 0;
+    fill(sortedEntries, next, 1);
+    assignDepths(1, nullptr, nullptr);
+}
+
+/* Purpose:
+ *    Recursively place sorted entries into Eytzinger slots
+ * Parameters:
+ *    sortedEntries – source entries in ascending order
+ *    next – index of the next entry to place (advanced as entries are consumed)
+ *    slot – current Eytzinger slot
+ * Behavior:
+ *    An in-order walk of the implicit tree visits slots in key order, so entries
+ *    are handed out sequentially and the arena ends up in key order too. Inline
+ *    prefixes are filled in afterwards by assignDepths
+ */
+void FrozenAVLTree::fill(const vector<EntryType>& sortedEntries, size_t& next, size_t slot) {
+    if (slot > treeSize) return;
+    fill(sortedEntries, next, 2 * slot);
+    const string_view suffix = string_view(sortedEntries[next].first).substr(commonPrefix.size());
+    Slot& entry = eytzSlots[slot];
+    if (suffix.size() >= LongKey) {
+        const auto length = static_cast<uint32_t>(suffix.size());
+        const char* lengthBytes = reinterpret_cast<const char*>(&length);
+        keyArena.insert(keyArena.end(), lengthBytes, lengthBytes + sizeof(length));
+        entry.keyLength = LongKey;
+    } else {
+        entry.keyLength = static_cast<uint16_t>(suffix.size());
+    }
+    entry.keyOffset = static_cast<uint32_t>(keyArena.size());
+    keyArena.insert(keyArena.end(), suffix.begin(), suffix.end());
+    eytzValues[slot] = sortedEntries[next].second;
+    next++;
+    fill(sortedEntries, next, 2 * slot + 1);
+}
+
+/* Purpose:
+ *    Record each slot's depth and the 8 key bytes found there
+ * Parameters:
+ *    slot – current Eytzinger slot
+ *    low, high – keys of the nearest ancestors the subtree lies right / left of,
+ *                or nullptr on the outer spines
+ * Behavior:
+ *    Every key in the subtree, and every query that descends into it, sorts between
+ *    low and high and so shares their common prefix; those bytes never need comparing
+ *    again, and the 8 bytes after them are the ones that tell the subtree's keys apart
+ */
+void FrozenAVLTree::assignDepths(size_t slot, const string_view* low, const string_view* high) {
+    if (slot > treeSize) return;
+    const string_view key = slotSuffix(slot);
+    size_t depth = 0;
+    if (low && high) {
+        depth = min(compareKeys(*low, *high).mismatch, static_cast<size_t>(UINT16_MAX));
+    }
+    eytzSlots[slot].depth = static_cast<uint16_t>(depth);
+    eytzSlots[slot].prefix = loadPrefix(key, depth);
+    assignDepths(2 * slot, low, &key);
+    assignDepths(2 * slot + 1, &key, high);
+}
+
+/* Purpose:
+ *    Return number of entries in the index
+ * Returns:
+ *    size_t treeSize
+ */
+size_t FrozenAVLTree::size() const {
+    return treeSize;
+}
+
+/* Purpose:
+ *    Pack 8 bytes of a key suffix into an integer that sorts like the bytes
+ * Parameters:
+ *    bytes – suffix to read (zero padded past its end)
+ *    offset – first byte to pack
+ * Returns:
+ *    big-endian value of those bytes
+ * Behavior:
+ *    If two packed values differ, they order the full keys correctly: either a real byte
+ *    differs, or one suffix ended and its zero padding sorts below the other's byte.
+ *    Equal values prove nothing beyond those bytes, so ties fall back to the arena
+ */
+uint64_t FrozenAVLTree::loadPrefix(std::string_view bytes, size_t offset) {
+    if constexpr (endian::native == endian::little) {
+        if (offset + sizeof(uint64_t) <= bytes.size()) {
+            uint64_t word;
+            memcpy(&word, bytes.data() + offset, sizeof(word));
+            return __builtin_bswap64(word);
+        }
+    }
+    unsigned char buffer[sizeof(uint64_t)] = {};
+    if (offset < bytes.size()) {
+        memcpy(buffer, bytes.data() + offset, min(bytes.size() - offset, sizeof(buffer)));
+    }
+    uint64_t value = 0;
+    for (const unsigned char byte : buffer) {
+        value = (value << 8) | byte;
+    }
+    return value;
+}
+
+/* Purpose:
+ *    View a slot's key without the shared commonPrefix
+ */
+std::string_view FrozenAVLTree::slotSuffix(size_t slot) const {
+    const Slot& entry = eytzSlots[slot];
+    const char* key = keyArena.data() + entry.keyOffset;
+    if (entry.keyLength != LongKey) {
+        return {key, entry.keyLength};
+    }
+    uint32_t length;
+    memcpy(&length, key - sizeof(length), sizeof(length));
+    return {key, length};
+}
+
+/* Purpose:
+ *    Rebuild the full key stored in a slot
+ */
+std::string FrozenAVLTree::slotKey(size_t slot) const {
+    string key = commonPrefix;
+    key.append(slotSuffix(slot));
+    return key;
+}
+
+/* Purpose:
+ *    Find the slot holding the smallest key >= key
+ * Parameters:
+ *    key – key to search for
+ * Returns:
+ *    slot index, or 0 if every key is less than key
+ * Behavior:
+ *    A key that leaves commonPrefix sorts before or after every stored key. Otherwise
+ *    each step compares the slot's inline 8 bytes against the key's bytes at the same
+ *    depth and only reads the arena on a tie, stopping at once on an exact match. Slots
+ *    three levels down are prefetched while the current one is compared. After falling
+ *    off the bottom, the trailing 1 bits of the slot are the right turns since the last
+ *    left turn; shifting them (and that left turn) out gives the answer
+ */
+size_t FrozenAVLTree::lowerBound(const std::string& key) const {
+    if (treeSize == 0) return 0;
+    const KeyCompareResult shared = compareKeys(key, commonPrefix);
+    if (shared.mismatch < commonPrefix.size()) {
+        // key ended inside commonPrefix or differs from it: all stored keys are on one side
+        return shared.order < 0 ? firstSlot() : 0;
+    }
+
+    const string_view suffix = string_view(key).substr(commonPrefix.size());
+    const Slot* slots = eytzSlots.data();
+    size_t slot = 1;
+    while (slot <= treeSize) {
+        __builtin_prefetch(slots + 8 * slot);
+        __builtin_prefetch(slots + 8 * slot + 4);
+        const Slot& current = slots[slot];
+        const uint64_t prefix = loadPrefix(suffix, current.depth);
+        bool goRight;
+        if (current.prefix != prefix) {
+            goRight = current.prefix < prefix;
+        } else {
+            const KeyCompareResult cmp = compareKeys(slotSuffix(slot), suffix, current.depth + sizeof(uint64_t));
+            if (cmp.order == 0) {
+                return slot;
+            }
+            goRight = cmp.order < 0;
+        }
+        slot = 2 * slot + static_cast<size_t>(goRight);
+    }
+    return slot >> (countr_one(slot) + 1);
+}
+
+/* Purpose:
+ *    Find the slot holding exactly key
+ * Parameters:
+ *    key – key to search for
+ * Returns:
+ *    slot index, or 0 if key is not stored
+ */
+size_t FrozenAVLTree::exactSlot(const std::string& key) const {
+    const size_t slot = lowerBound(key);
+    if (slot == 0 || key.compare(0, commonPrefix.size(), commonPrefix) != 0) {
+        return 0;
+    }
+    return slotSuffix(slot) == string_view(key).substr(commonPrefix.size()) ? slot : 0;
+}
+
+/* Purpose:
+ *    Return the slot holding the smallest key
+ * Returns:
+ *    leftmost slot, or 0 if the index is empty
+ */
+size_t FrozenAVLTree::firstSlot() const {
+    if (treeSize == 0) return 0;
+    size_t slot = 1;
+    while (2 * slot <= treeSize) {
+        slot = 2 * slot;
+    }
+    return slot;
+}
+
+/* Purpose:
+ *    Return the slot holding the next larger key after slot
+ * Parameters:
+ *    slot – current slot (must be non-zero)
+ * Returns:
+ *    slot of the in-order successor, or 0 if slot holds the largest key
+ */
+size_t FrozenAVLTree::nextSlot(size_t slot) const {
+    if (2 * slot + 1 <= treeSize) {
+        slot = 2 * slot + 1;
+        while (2 * slot <= treeSize) {
+            slot = 2 * slot;
+        }
+        return slot;
+    }
+    // climb while we are a right child (odd slot), then step to the parent
+    while (slot & 1) {
+        slot >>= 1;
+    }
+    return slot >> 1;
+}
+
+/* Purpose:
+ *    Check whether the index contains a key
+ * Parameters:
+ *    key – key to search for
+ * Returns:
+ *    true if found, false otherwise
+ */
+bool FrozenAVLTree::contains(const std::string& key) const {
+    if (storage == KeyStorage::FrontCoded) {
+        return get(key).has_value();
+    }
+    return exactSlot(key) != 0;
+}
+
+/* Purpose:
+ *    Retrieve value for key safely
+ * Parameters:
+ *    key – key to look up
+ * Returns:
+ *    optional<size_t> containing the value if found; nullopt otherwise
+ */
+optional<size_t> FrozenAVLTree::get(const std::string& key) const {
+    if (storage == KeyStorage::FrontCoded) {
+        string found;
+        size_t nextOffset = 0;
+        const size_t index = frontCodedLowerBound(key, found, nextOffset);
+        if (index < treeSize && found == key) {
+            return sortedValues[index];
+        }
+        return nullopt;
+    }
+    const size_t slot = exactSlot(key);
+    if (slot) {
+        return eytzValues[slot];
+    }
+    return nullopt;
+}
+
+/* Purpose:
+ *    Range query returning values whose keys are within [lowKey, highKey]
+ * Parameters:
+ *    lowKey, highKey – inclusive bounds
+ * Returns:
+ *    vector of values in ascending key order
+ */
+vector<size_t> FrozenAVLTree::findRange(const std::string& lowKey, const std::string& highKey) const {
+    vector<size_t> result;
+    if (storage == KeyStorage::FrontCoded) {
+        string current;
+        size_t offset = 0;
+        for (size_t index = frontCodedLowerBound(lowKey, current, offset); index < treeSize; index++) {
+            if (current > highKey) break;
+            result.push_back(sortedValues[index]);
+            if (index + 1 < treeSize) {
+                offset = decodeKey(offset, current);
+            }
+        }
+        return result;
+    }
+    // every stored key starts with commonPrefix, so highKey is checked against it once and
+    // the walk only compares suffixes; a highKey above the prefix bounds nothing
+    const KeyCompareResult shared = compareKeys(highKey, commonPrefix);
+    const bool leavesPrefix = shared.mismatch < commonPrefix.size();
+    if (leavesPrefix && shared.order < 0) return result;
+    const string_view highSuffix = leavesPrefix ? string_view() : string_view(highKey).substr(commonPrefix.size());
+    for (size_t slot = lowerBound(lowKey); slot; slot = nextSlot(slot)) {
+        if (!leavesPrefix && compareKeys(slotSuffix(slot), highSuffix).order > 0) break;
+        result.push_back(eytzValues[slot]);
+    }
+    return result;
+}
+
+/* Purpose:
+ *    Return a vector of all (key, value) pairs in ascending key order
+ */
+vector<FrozenAVLTree::EntryType> FrozenAVLTree::entries() const {
+    vector<EntryType> result;
+    result.reserve(treeSize);
+    if (treeSize == 0) return result;
+    if (storage == KeyStorage::FrontCoded) {
+        string current;
+        size_t offset = 0;
+        for (size_t index = 0; index < treeSize; index++) {
+            offset = decodeKey(offset, current);
+            result.emplace_back(current, sortedValues[index]);
+        }
+        return result;
+    }
+    for (size_t slot = firstSlot(); slot; slot = nextSlot(slot)) {
+        result.emplace_back(slotKey(slot), eytzValues[slot]);
+    }
+    return result;
+}
+
+/* Purpose:
+ *    Return a vector of all keys in sorted (ascending) order
+ * Returns:
+ *    vector<string> of keys
+ */
+vector<std::string> FrozenAVLTree::keys() const {
+    vector<std::string> result;
+    result.reserve(treeSize);
+    if (treeSize == 0) return result;
+    if (storage == KeyStorage::FrontCoded) {
+        string current;
+        size_t offset = 0;
+        for (size_t index = 0; index < treeSize; index++) {
+            offset = decodeKey(offset, current);
+            result.push_back(current);
+        }
+        return result;
+    }
+    for (size_t slot = firstSlot(); slot; slot = nextSlot(slot)) {
+        result.push_back(slotKey(slot));
+    }
+    return result;
+}
+
+/* Purpose:
+ *    Convert the frozen index back into a mutable AVLTree
+ * Returns:
+ *    AVLTree holding the same entries
+ * Behavior:
+ *    Builds a perfectly balanced tree directly from the sorted entries in O(n)
+ */
+AVLTree FrozenAVLTree::thaw() const {
+    AVLTree tree;
+    const vector<EntryType> sorted = entries();
+    tree.root = tree.buildFromSorted(sorted, 0, sorted.size(), nullptr);
+    tree.treeSize = sorted.size();
+    return tree;
+}
+
+/* Purpose:
+ *    Encode sorted entries into the front-coded arena
+ * Parameters:
+ *    sortedEntries – (key, value) pairs in strictly ascending key order
+ * Behavior:
+ *    Each key is written as (shared, suffix length, suffix), where shared is the number of
+ *    leading bytes it has in common with the previous key. The first key of every block
+ *    uses shared = 0 so decoding can start at any block
+ */
+void FrozenAVLTree::buildFrontCoded(const vector<EntryType>& sortedEntries) {
+    sortedValues.reserve(treeSize);
+    blockOffsets.reserve((treeSize + FrontCodedBlockSize - 1) / FrontCodedBlockSize);
+
+    const string* previous = nullptr;
+    for (size_t index = 0; index < treeSize; index++) {
+        const string& key = sortedEntries[index].first;
+        size_t shared = 0;
+        if (index % FrontCodedBlockSize == 0) {
+            blockOffsets.push_back(keyArena.size());
+        } else {
+            const size_t limit = min(previous->size(), key.size());
+            while (shared < limit && (*previous)[shared] == key[shared]) {
+                shared++;
+            }
+        }
+        writeVarint(keyArena, shared);
+        writeVarint(keyArena, key.size() - shared);
+        keyArena.insert(keyArena.end(), key.begin() + static_cast<ptrdiff_t>(shared), key.end());
+        sortedValues.push_back(sortedEntries[index].second);
+        previous = &key;
+    }
+    keyArena.shrink_to_fit();
+}
+
+/* Purpose:
+ *    Decode the front-coded key at offset on top of the previous key
+ * Parameters:
+ *    offset – arena offset of the encoded key
+ *    key – holds the previous key on entry (ignored at a block head), the decoded key on return
+ * Returns:
+ *    arena offset of the next encoded key
+ */
+size_t FrozenAVLTree::decodeKey(size_t offset, std::string& key) const {
+    const size_t shared = readVarint(keyArena, offset);
+    const size_t suffixLength = readVarint(keyArena, offset);
+    key.resize(shared);
+    key.append(keyArena.data() + offset, suffixLength);
+    return offset + suffixLength;
+}
+
+/* Purpose:
+ *    View the full first key of a block without copying it
+ * Parameters:
+ *    block – block index
+ * Returns:
+ *    string_view into the arena
+ */
+std::string_view FrozenAVLTree::blockHead(size_t block) const {
+    size_t offset = blockOffsets[block];
+    readVarint(keyArena, offset); // shared, always 0 for a block head
+    const size_t length = readVarint(keyArena, offset);
+    return {keyArena.data() + offset, length};
+}
+
+/* Purpose:
+ *    Find the sorted index of the smallest key >= key in the front-coded arena
+ * Parameters:
+ *    key – key to search for
+ *    foundKey – set to the key at the returned index
+ *    nextOffset – set to the arena offset just past that key, for continuing a scan
+ * Returns:
+ *    sorted index, or size() if every key is less than key
+ * Behavior:
+ *    Binary search picks the last block whose head is <= key, then that block is
+ *    decoded in order. If the whole block is smaller, the answer is the next block head
+ */
+size_t FrozenAVLTree::frontCodedLowerBound(const std::string& key, std::string& foundKey, size_t& nextOffset) const {
+    size_t lowBlock = 0;
+    size_t highBlock = blockOffsets.size();
+    while (lowBlock < highBlock) {
+        const size_t middle = lowBlock + (highBlock - lowBlock) / 2;
+        if (blockHead(middle) <= key) {
+            lowBlock = middle + 1;
+        } else {
+            highBlock = middle;
+        }
+    }
+    const size_t block = lowBlock == 0 ? 0 : lowBlock - 1;
+
+    size_t offset = block < blockOffsets.size() ? blockOffsets[block] : keyArena.size();
+    for (size_t index = block * FrontCodedBlockSize; index < treeSize; index++) {
+        offset = decodeKey(offset, foundKey);
+        if (foundKey >= key) {
+            nextOffset = offset;
+            return index;
+        }
+    }
+    return treeSize;
+}
+
+/* Purpose:
+ *    Report which key layout this index uses
+ * Returns:
+ *    KeyStorage::Plain or KeyStorage::FrontCoded
+ */
+AVLTree::KeyStorage FrozenAVLTree::keyStorage() const {
+    return storage;
+}
+
+/* Purpose:
+ *    Approximate the memory held by the index
+ * Returns:
+ *    bytes for the object itself, the arrays' capacity and any heap-allocated key buffers
+ */
+size_t FrozenAVLTree::memoryUsage() const {
+    size_t bytes = sizeof(FrozenAVLTree);
+    bytes += eytzSlots.capacity() * sizeof(Slot);
+    bytes += eytzValues.capacity() * sizeof(ValueType);
+    if (commonPrefix.capacity() > KeyType().capacity()) {
+        bytes += commonPrefix.capacity() + 1;
+    }
+    bytes += keyArena.capacity();
+    bytes += blockOffsets.capacity() * sizeof(size_t);
+    bytes += sortedValues.capacity() * sizeof(ValueType);
+    return bytes;
+}
@@ -0,0 +1,104 @@
+/*
+ * FrozenAVLTree.h
+ */
+
+#ifndef FROZENAVLTREE_H
+#define FROZENAVLTREE_H
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "AVLTree.h"
+
+class FrozenAVLTree {
+    public:
+    using KeyType = AVLTree::KeyType;
+    using ValueType = AVLTree::ValueType;
+    using EntryType = AVLTree::EntryType;
+    using KeyStorage = AVLTree::KeyStorage;
+
+    // number of keys per front-coded block; the first key of each block is stored in full
+    static constexpr size_t FrontCodedBlockSize = 16;
+
+    FrozenAVLTree();
+
+    // sortedEntries must be in strictly ascending key order
+    explicit FrozenAVLTree(const std::vector<EntryType>& sortedEntries, KeyStorage storage = KeyStorage::Plain);
+
+    [[nodiscard]] size_t size() const;
+
+    [[nodiscard]] bool contains(const std::string& key) const;
+
+    [[nodiscard]] std::optional<size_t> get(const std::string& key) const;
+
+    [[nodiscard]] std::vector<size_t> findRange(const std::string& lowKey, const std::string& highKey) const;
+
+    [[nodiscard]] std::vector<std::string> keys() const;
+
+    [[nodiscard]] AVLTree thaw() const;
+
+    [[nodiscard]] KeyStorage keyStorage() const;
+
+    // approximate heap + object bytes held by the index
+    [[nodiscard]] size_t memoryUsage() const;
+
+    private:
+    // one Eytzinger slot, four to a cache line
+    struct Slot {
+        // the 8 key bytes starting at depth, zero padded and big-endian so integer order is key order
+        uint64_t prefix;
+        // key (everything after commonPrefix) in keyArena
+        uint32_t keyOffset;
+        // LongKey means the real length is a uint32_t stored in the arena just before the key
+        uint16_t keyLength;
+        // bytes every key (and every query) reaching this slot shares with it, capped at UINT16_MAX
+        uint16_t depth;
+    };
+    static constexpr uint16_t LongKey = UINT16_MAX;
+
+    KeyStorage storage;
+    size_t treeSize;
+
+    // KeyStorage::Plain – Eytzinger (BFS) order: slot k has children 2k and 2k+1, slot 0 is unused
+    std::vector<Slot> eytzSlots;
+    std::vector<ValueType> eytzValues;
+    // prefix shared by every key, stripped from the arena copies
+    std::string commonPrefix;
+
+    // Plain: key suffixes in sorted order. FrontCoded: keys in sorted order, each stored as
+    // (bytes shared with previous key, suffix length, suffix)
+    std::vector<char> keyArena;
+    std::vector<size_t> blockOffsets;
+    std::vector<ValueType> sortedValues;
+
+    void buildFrontCoded(const std::vector<EntryType>& sortedEntries);
+
+    size_t decodeKey(size_t offset, std::string& key) const;
+
+    [[nodiscard]] std::string_view blockHead(size_t block) const;
+
+    size_t frontCodedLowerBound(const std::string& key, std::string& foundKey, size_t& nextOffset) const;
+
+    void fill(const std::vector<EntryType>& sortedEntries, size_t& next, size_t slot);
+
+    void assignDepths(size_t slot, const std::string_view* low, const std::string_view* high);
+
+    static uint64_t loadPrefix(std::string_view bytes, size_t offset);
+
+    [[nodiscard]] std::string_view slotSuffix(size_t slot) const;
+
+    [[nodiscard]] std::string slotKey(size_t slot) const;
+
+    [[nodiscard]] size_t lowerBound(const std::string& key) const;
+
+    [[nodiscard]] size_t exactSlot(const std::string& key) const;
+
+    [[nodiscard]] size_t firstSlot() const;
+
+    [[nodiscard]] size_t nextSlot(size_t slot) const;
+
+    [[nodiscard]] std::vector<EntryType> entries() const;
+};
+
+#endif //FROZENAVLTREE_H
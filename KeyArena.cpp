@@ -0,0 +1,287 @@
+/* Filename: KeyArena.cpp
+ * Project: Project - AVLTree
+ * Program Description:
+ *    Chunked storage for AVLTree keys. A std::string key costs a 32-byte object in
+ *    the node plus, past 15 characters, a heap buffer with its own malloc header and
+ *    rounding. Here keys are bump-allocated out of ChunkSize chunks in 8-byte size
+ *    classes, so a node only holds a string_view and the bytes themselves carry no
+ *    per-key allocator overhead. Released keys are kept on intrusive free lists, one
+ *    per size class, and handed out again before the chunk is extended. Keys longer
+ *    than LargeKey are rare enough to get their own allocation.
+ */
+#include "KeyArena.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+using namespace std;
+
+/* Purpose:
+ *    Construct an empty arena; no chunk is allocated until the first key is stored
+ */
+KeyArena::KeyArena() {
+    cursor = nullptr;
+    remaining = 0;
+    reserved = 0;
+    used = 0;
+}
+
+/* Purpose:
+ *    Move constructor; other is left empty
+ */
+KeyArena::KeyArena(KeyArena&& other) noexcept
+    : chunks(std::move(other.chunks)),
+      cursor(other.cursor),
+      remaining(other.remaining),
+      freeLists(std::move(other.freeLists)),
+      largeKeys(std::move(other.largeKeys)),
+      reserved(other.reserved),
+      used(other.used) {
+    other.chunks.clear();
+    other.freeLists.clear();
+    other.largeKeys.clear();
+    other.cursor = nullptr;
+    other.remaining = 0;
+    other.reserved = 0;
+    other.used = 0;
+}
+
+/* Purpose:
+ *    Move assignment; frees this arena's keys first, other is left empty
+ */
+KeyArena& KeyArena::operator=(KeyArena&& other) noexcept {
+    if (this == &other) return *this;
+    freeAll();
+    chunks = std::move(other.chunks);
+    cursor = other.cursor;
+    remaining = other.remaining;
+    freeLists = std::move(other.freeLists);
+    largeKeys = std::move(other.largeKeys);
+    reserved = other.reserved;
+    used = other.used;
+    other.chunks.clear();
+    other.freeLists.clear();
+    other.largeKeys.clear();
+    other.cursor = nullptr;
+    other.remaining = 0;
+    other.reserved = 0;
+    other.used = 0;
+    return *this;
+}
+
+/* Purpose:
+ *    Destructor; every view handed out by store becomes invalid
+ */
+KeyArena::~KeyArena() {
+    freeAll();
+}
+
+/* Purpose:
+ *    Return every chunk and large key to the allocator
+ */
+void KeyArena::freeAll() {
+    for (char* key : largeKeys) {
+        delete[] key;
+    }
+    largeKeys.clear();
+    chunks.clear();
+    freeLists.clear();
+    cursor = nullptr;
+    remaining = 0;
+    reserved = 0;
+    used = 0;
+}
+
+/* Purpose:
+ *    Size of the slot that holds a key of this length
+ * Returns:
+ *    length rounded up to a multiple of 8, at least 8 so a free slot can hold a link
+ */
+size_t KeyArena::slotSize(size_t length) {
+    return max<size_t>(8, (length + 7) & ~static_cast<size_t>(7));
+}
+
+/* Purpose:
+ *    Estimate how many bytes the allocator really uses for a request
+ * Parameters:
+ *    requested – bytes passed to operator new
+ * Returns:
+ *    estimated chunk size
+ * Behavior:
+ *    Models a glibc-style malloc: an 8-byte header, 16-byte alignment and a
+ *    32-byte minimum chunk. Other allocators will differ somewhat
+ */
+size_t KeyArena::allocationSize(size_t requested) {
+    const size_t chunk = (requested + sizeof(size_t) + 15) & ~static_cast<size_t>(15);
+    return max<size_t>(chunk, 32);
+}
+
+/* Purpose:
+ *    Estimate the bytes a key of this length occupies
+ * Returns:
+ *    0 for an empty key, the slot size for a chunked key, and allocationSize for a
+ *    large key
+ */
+size_t KeyArena::footprint(size_t length) {
+    if (length == 0) return 0;
+    if (length > LargeKey) {
+        return allocationSize(length);
+    }
+    return slotSize(length);
+}
+
+/* Purpose:
+ *    Copy a key into the arena
+ * Parameters:
+ *    key – bytes to store
+ * Returns:
+ *    view of the stored copy (an empty view for an empty key)
+ * Behavior:
+ *    Reuses a free slot of the same size class if there is one, otherwise takes the
+ *    next bytes of the current chunk. When the chunk runs out its unused tail goes on
+ *    the free list that fits it and a new chunk is started
+ */
+string_view KeyArena::store(string_view key) {
+    if (key.empty()) return {};
+    if (key.size() > LargeKey) {
+        char* bytes = new char[key.size()];
+        memcpy(bytes, key.data(), key.size());
+        largeKeys.insert(bytes);
+        reserved += footprint(key.size());
+        used += footprint(key.size());
+        return {bytes, key.size()};
+    }
+
+    const size_t size = slotSize(key.size());
+    const size_t sizeClass = size / 8;
+    char* slot;
+    if (sizeClass < freeLists.size() && freeLists[sizeClass]) {
+        slot = freeLists[sizeClass];
+        memcpy(&freeLists[sizeClass], slot, sizeof(char*));
+    } else {
+        if (remaining < size) {
+            recycle(cursor, remaining);
+            chunks.emplace_back(new char[ChunkSize]);
+            reserved += ChunkSize;
+            cursor = chunks.back().get();
+            remaining = ChunkSize;
+        }
+        slot = cursor;
+        cursor += size;
+        remaining -= size;
+    }
+    used += size;
+    memcpy(slot, key.data(), key.size());
+    return {slot, key.size()};
+}
+
+/* Purpose:
+ *    Give back a key returned by store
+ * Parameters:
+ *    key – view returned by store (empty views are ignored)
+ * Behavior:
+ *    Large keys are freed at once; chunked slots are pushed on their size class's
+ *    free list, so chunk memory is only returned to the allocator with the arena.
+ *    Slots are neither split nor merged, so when key lengths drift the owner has to
+ *    compare usedBytes with reservedBytes and copy the live keys into a fresh arena
+ */
+void KeyArena::release(string_view key) {
+    if (key.empty()) return;
+    char* bytes = const_cast<char*>(key.data());
+    if (key.size() > LargeKey) {
+        largeKeys.erase(bytes);
+        reserved -= footprint(key.size());
+        used -= footprint(key.size());
+        delete[] bytes;
+        return;
+    }
+
+    used -= slotSize(key.size());
+    recycle(bytes, slotSize(key.size()));
+}
+
+/* Purpose:
+ *    Put unused chunk bytes on the free lists
+ * Parameters:
+ *    bytes – start of the range (8-byte aligned within its chunk)
+ *    size – length of the range, a multiple of 8
+ * Behavior:
+ *    Ranges longer than the largest chunked slot are cut into LargeKey pieces
+ */
+void KeyArena::recycle(char* bytes, size_t size) {
+    while (size >= 8) {
+        const size_t piece = min(size, LargeKey);
+        const size_t sizeClass = piece / 8;
+        if (freeLists.size() <= sizeClass) {
+            freeLists.resize(sizeClass + 1, nullptr);
+        }
+        memcpy(bytes, &freeLists[sizeClass], sizeof(char*));
+        freeLists[sizeClass] = bytes;
+        bytes += piece;
+        size -= piece;
+    }
+}
+
+/* Purpose:
+ *    Take ownership of every key stored in other
+ * Parameters:
+ *    other – arena to empty; views into it stay valid and now belong to this arena
+ * Behavior:
+ *    Chunks and large keys are moved over without copying any key bytes. other's
+ *    free slots, and the smaller of the two unused chunk tails, join this arena's
+ *    free lists
+ */
+void KeyArena::adopt(KeyArena&& other) {
+    if (this == &other) return;
+    for (unique_ptr<char[]>& chunk : other.chunks) {
+        chunks.push_back(std::move(chunk));
+    }
+    largeKeys.merge(other.largeKeys);
+    reserved += other.reserved;
+    used += other.used;
+    // keep bump-allocating from whichever chunk has more room left
+    if (other.remaining > remaining) {
+        swap(cursor, other.cursor);
+        swap(remaining, other.remaining);
+    }
+    recycle(other.cursor, other.remaining);
+    for (size_t sizeClass = 1; sizeClass < other.freeLists.size(); sizeClass++) {
+        char* slot = other.freeLists[sizeClass];
+        while (slot) {
+            char* next;
+            memcpy(&next, slot, sizeof(char*));
+            recycle(slot, sizeClass * 8);
+            slot = next;
+        }
+    }
+
+    other.chunks.clear();
+    other.freeLists.clear();
+    other.largeKeys.clear();
+    other.cursor = nullptr;
+    other.remaining = 0;
+    other.reserved = 0;
+    other.used = 0;
+}
+
+/* Purpose:
+ *    Report the bytes this arena holds from the allocator
+ * Returns:
+ *    chunk bytes (used, free-listed or not yet handed out) plus the estimated
+ *    allocations of large keys
+ */
+size_t KeyArena::reservedBytes() const {
+    return reserved;
+}
+
+/* Purpose:
+ *    Report the bytes taken by keys that are still stored
+ * Returns:
+ *    sum of footprint over every live key; reservedBytes minus this is space that is
+ *    free-listed or not yet handed out
+ */
+size_t KeyArena::usedBytes() const {
+    return used;
+}
@@ -0,0 +1,73 @@
+/*
+ * KeyArena.h
+ */
+
+#ifndef KEYARENA_H
+#define KEYARENA_H
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Owns the key bytes of one AVLTree. Keys are packed into large chunks instead of one
+// heap buffer each; freed keys go on per-size free lists and are reused by later keys
+class KeyArena {
+    public:
+    // bytes per chunk; keys longer than LargeKey get an allocation of their own
+    static constexpr size_t ChunkSize = 64 * 1024;
+    static constexpr size_t LargeKey = 1024;
+
+    KeyArena();
+
+    KeyArena(KeyArena&& other) noexcept;
+
+    KeyArena& operator=(KeyArena&& other) noexcept;
+
+    KeyArena(const KeyArena&) = delete;
+
+    KeyArena& operator=(const KeyArena&) = delete;
+
+    ~KeyArena();
+
+    // copy key into the arena; the view stays valid until it is released or the arena dies
+    std::string_view store(std::string_view key);
+
+    // give back a view returned by store
+    void release(std::string_view key);
+
+    // take over every key and free slot of other, leaving it empty
+    void adopt(KeyArena&& other);
+
+    // bytes this arena holds from the allocator
+    [[nodiscard]] size_t reservedBytes() const;
+
+    // bytes taken by live keys; the rest of reservedBytes is free or not yet handed out
+    [[nodiscard]] size_t usedBytes() const;
+
+    // bytes a key of this length occupies, including size-class rounding
+    static size_t footprint(size_t length);
+
+    // estimated bytes malloc really uses for a request; the one allocator model that
+    // key footprints and AVLTree's memory accounting share
+    static size_t allocationSize(size_t requested);
+
+    private:
+    std::vector<std::unique_ptr<char[]>> chunks;
+    // unused tail of the newest chunk
+    char* cursor;
+    size_t remaining;
+    // freeLists[c] heads a list of free slots of c * 8 bytes, linked through their first 8 bytes
+    std::vector<char*> freeLists;
+    std::unordered_set<char*> largeKeys;
+    size_t reserved;
+    size_t used;
+
+    static size_t slotSize(size_t length);
+
+    void recycle(char* bytes, size_t size);
+
+    void freeAll();
+};
+
+#endif //KEYARENA_H
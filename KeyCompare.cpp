@@ -0,0 +1,193 @@
+/* Filename: KeyCompare.cpp
+ * Project: Project - AVLTree
+ * Program Description:
+ *    Three-way string key comparison that also reports where the keys first differ.
+ *    The mismatch search uses AVX2 or SSE2 vector compares when the CPU supports
+ *    them (picked once at runtime) and a word-at-a-time scalar loop otherwise.
+ *    Callers that already know a common prefix can pass it as skip so those bytes
+ *    are never looked at again. compareKeys itself is inline in KeyCompare.h so the
+ *    common first-word mismatch never leaves the caller.
+ */
+#include "KeyCompare.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define KEYCOMPARE_X86 1
+#include <immintrin.h>
+#endif
+using namespace std;
+
+namespace {
+
+using MismatchFunction = size_t (*)(const char* a, const char* b, size_t length);
+
+/* Purpose:
+ *    Find the first differing byte of a and b, eight bytes at a time
+ * Parameters:
+ *    a, b – byte ranges to compare
+ *    length – number of bytes available in both ranges
+ * Returns:
+ *    index of the first differing byte, or length if all bytes match
+ * Behavior:
+ *    Plain integer code, so it can be inlined into the vector kernels for their
+ *    short tails without mixing legacy SSE and VEX encodings
+ */
+inline size_t mismatchScalar(const char* a, const char* b, size_t length) {
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t wordA;
+        uint64_t wordB;
+        memcpy(&wordA, a + i, sizeof(wordA));
+        memcpy(&wordB, b + i, sizeof(wordB));
+        if (wordA != wordB) {
+            if constexpr (endian::native == endian::little) {
+                return i + countr_zero(wordA ^ wordB) / 8;
+            }
+            break;
+        }
+    }
+    while (i < length && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+size_t mismatchScalarKernel(const char* a, const char* b, size_t length) {
+    return mismatchScalar(a, b, length);
+}
+
+#ifdef KEYCOMPARE_X86
+/* Purpose:
+ *    SSE2 mismatch search, 16 bytes per step
+ * Parameters / Returns:
+ *    same as mismatchScalar
+ * Behavior:
+ *    The last partial block is handled by one overlapping load ending at length;
+ *    the bytes it re-reads are already known to match
+ */
+__attribute__((target("sse2")))
+size_t mismatchSse2(const char* a, const char* b, size_t length) {
+    if (length < 16) {
+        return mismatchScalar(a, b, length);
+    }
+    size_t i = 0;
+    while (true) {
+        const __m128i blockA = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i blockB = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        const unsigned equalMask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(blockA, blockB)));
+        if (equalMask != 0xFFFFu) {
+            return i + countr_one(equalMask);
+        }
+        if (i + 16 == length) return length;
+        i = min(i + 16, length - 16);
+    }
+}
+
+/* Purpose:
+ *    AVX2 mismatch search, 32 bytes per step
+ * Parameters / Returns:
+ *    same as mismatchScalar
+ * Behavior:
+ *    Same overlapping-tail scheme as mismatchSse2. Ranges of 16–31 bytes use 128-bit
+ *    VEX compares from this same function, so no legacy SSE code runs while the upper
+ *    YMM state is dirty (that transition costs far more than the compare itself)
+ */
+__attribute__((target("avx2")))
+size_t mismatchAvx2(const char* a, const char* b, size_t length) {
+    if (length < 16) {
+        return mismatchScalar(a, b, length);
+    }
+    if (length < 32) {
+        const __m128i headA = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        const __m128i headB = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        unsigned equalMask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(headA, headB)));
+        if (equalMask != 0xFFFFu) {
+            return countr_one(equalMask);
+        }
+        const size_t tail = length - 16;
+        const __m128i tailA = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + tail));
+        const __m128i tailB = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + tail));
+        equalMask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(tailA, tailB)));
+        return equalMask != 0xFFFFu ? tail + countr_one(equalMask) : length;
+    }
+    size_t i = 0;
+    while (true) {
+        const __m256i blockA = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        const __m256i blockB = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        const auto equalMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(blockA, blockB)));
+        if (equalMask != 0xFFFFFFFFu) {
+            return i + countr_one(equalMask);
+        }
+        if (i + 32 == length) return length;
+        i = min(i + 32, length - 32);
+    }
+}
+#endif
+
+/* Purpose:
+ *    Pick the widest mismatch kernel this CPU supports
+ * Returns:
+ *    kernel function
+ */
+MismatchFunction selectKernel() {
+#ifdef KEYCOMPARE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return mismatchAvx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return mismatchSse2;
+    }
+#endif
+    return mismatchScalarKernel;
+}
+
+size_t resolveAndMismatch(const char* a, const char* b, size_t length);
+
+// starts at the resolver, which swaps in the selected kernel on the first call;
+// after that every compare is one plain load and an indirect call, with no init guard
+atomic<MismatchFunction> mismatchKernel{resolveAndMismatch};
+
+/* Purpose:
+ *    First-call trampoline: select the kernel, publish it, and run it
+ */
+size_t resolveAndMismatch(const char* a, const char* b, size_t length) {
+    const MismatchFunction kernel = selectKernel();
+    mismatchKernel.store(kernel, memory_order_relaxed);
+    return kernel(a, b, length);
+}
+
+} // namespace
+
+/* Purpose:
+ *    Find the first differing byte of two equal-length ranges
+ * Parameters:
+ *    a, b – byte ranges to compare
+ *    length – number of bytes available in both ranges
+ * Returns:
+ *    index of the first differing byte, or length if all bytes match
+ * Behavior:
+ *    Runs the kernel selected on the first call; later calls are one load and an indirect call
+ */
+size_t findMismatch(const char* a, const char* b, size_t length) {
+    return mismatchKernel.load(memory_order_relaxed)(a, b, length);
+}
+
+/* Purpose:
+ *    Report which mismatch kernel is in use
+ * Returns:
+ *    "avx2", "sse2" or "scalar"
+ */
+const char* keyCompareKernel() {
+    const MismatchFunction kernel = selectKernel();
+#ifdef KEYCOMPARE_X86
+    if (kernel == mismatchAvx2) return "avx2";
+    if (kernel == mismatchSse2) return "sse2";
+#endif
+    return "scalar";
+}
@@ -0,0 +1,70 @@
+/*
+ * KeyCompare.h
+ */
+
+#ifndef KEYCOMPARE_H
+#define KEYCOMPARE_H
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+struct KeyCompareResult {
+    // negative, zero or positive, like std::string::compare
+    int order;
+    // index of the first differing byte, or the shorter length if one key is a prefix of the other
+    size_t mismatch;
+};
+
+// index of the first differing byte of a and b (or length), using the vector kernel picked for this CPU
+size_t findMismatch(const char* a, const char* b, size_t length);
+
+/* Purpose:
+ *    Three-way compare two keys and report the first differing byte
+ * Parameters:
+ *    a, b – keys to compare
+ *    skip – number of leading bytes the caller already knows are equal
+ * Returns:
+ *    KeyCompareResult with order (<0, 0, >0 as a is less, equal, greater than b)
+ *    and mismatch (length of the common prefix of a and b)
+ * Behavior:
+ *    Bytes are compared as unsigned char, matching std::string::compare. Inline because
+ *    it sits on every step of every descent: keys usually differ within the first word
+ *    after skip, and that case is settled here without a call
+ */
+inline KeyCompareResult compareKeys(std::string_view a, std::string_view b, size_t skip = 0) {
+    const size_t shorter = std::min(a.size(), b.size());
+    skip = std::min(skip, shorter);
+    const size_t remaining = shorter - skip;
+
+    size_t mismatch;
+    uint64_t wordA = 0;
+    uint64_t wordB = 0;
+    if (std::endian::native == std::endian::little && remaining >= sizeof(uint64_t)) {
+        std::memcpy(&wordA, a.data() + skip, sizeof(wordA));
+        std::memcpy(&wordB, b.data() + skip, sizeof(wordB));
+    }
+    if (wordA != wordB) {
+        mismatch = skip + std::countr_zero(wordA ^ wordB) / 8;
+    } else {
+        mismatch = skip + findMismatch(a.data() + skip, b.data() + skip, remaining);
+    }
+
+    if (mismatch < shorter) {
+        const auto byteA = static_cast<unsigned char>(a[mismatch]);
+        const auto byteB = static_cast<unsigned char>(b[mismatch]);
+        return {byteA < byteB ? -1 : 1, mismatch};
+    }
+    if (a.size() == b.size()) {
+        return {0, mismatch};
+    }
+    return {a.size() < b.size() ? -1 : 1, mismatch};
+}
+
+// name of the byte-compare kernel picked for this CPU ("avx2", "sse2" or "scalar")
+const char* keyCompareKernel();
+
+#endif //KEYCOMPARE_H